@@ -8,39 +8,173 @@
 #include "chesslib/square.h"
 #include "chesslib/piece.h"
 #include "chesslib/movelist.h"
+#include "chesslib/movebuffer.h"
+#include "chesslib/squareset.h"
 
 #define INITIAL_FEN "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1"
 
+// The most space a FEN written by boardWriteFen can take, including the null terminator
+#define FEN_MAX_LENGTH 94
+
 #define CASTLE_WK 0b0001
 #define CASTLE_WQ 0b0010
 #define CASTLE_BK 0b0100
 #define CASTLE_BQ 0b1000
 
+// Slots of board.materialCounts. Each piece is counted under its own value, except that bishops on dark squares get
+// slots of their own, so pWBishop and pBBishop count light squared bishops. pEmpty counts empty squares
+#define MATERIAL_W_DARK_BISHOP 13
+#define MATERIAL_B_DARK_BISHOP 14
+#define MATERIAL_SLOTS 16
+
+// Laid out so the bitboards, hash and game state (the parts move generation reads most) fill the first 80 bytes,
+// followed by the material counts and half a byte per square. The whole board is 128 bytes, two cache lines
 typedef struct
 {
-	piece pieces[64];
-	pieceColor currentPlayer;
+	// Occupancy bitboards, kept in sync with packedPieces by boardSetPiece. Empty squares aren't stored, they're the
+	// ones in neither color. Read these with boardGetTypeSet and boardGetColorSet
+	sqSet typeSets[6]; 	// Indexed by pieceType - 1
+	sqSet colorSets[2]; 	// Indexed by pieceColor - 1
+
+	// Zobrist hash of the position, kept up to date by boardSetPiece and boardPlayMoveInPlace
+	uint64_t hash;
+
+	uint8_t currentPlayer; 	// A pieceColor
 	uint8_t castleState; 	// Bitmask describing castle state
 	sq epTarget;
-	unsigned int halfMoveClock;
-	unsigned int moveNumber;
+	uint16_t halfMoveClock;
+	uint16_t moveNumber;
+
+	// How many of each piece there are, kept up to date by boardSetPiece. See MATERIAL_SLOTS
+	uint8_t materialCounts[MATERIAL_SLOTS];
+
+	// A piece on each square, two to a byte with the lower square in the low 4 bits. Read with boardGetPieceAt
+	uint8_t packedPieces[32];
 } board;
 
+// Returns the set of squares with the given type of piece on them, of either color. Not for ptEmpty
+static inline sqSet boardGetTypeSet(board *b, pieceType pt)
+{
+	return b->typeSets[pt - 1];
+}
+
+// Returns the set of squares with the given color of piece on them. Not for pcNoColor
+static inline sqSet boardGetColorSet(board *b, pieceColor pc)
+{
+	return b->colorSets[pc - 1];
+}
+
+// Returns the piece on the square with the given index (0-63)
+static inline piece boardGetPieceAt(board *b, uint8_t index)
+{
+	return (piece) ((b->packedPieces[index >> 1] >> ((index & 1) << 2)) & 0xF);
+}
+
+// What went wrong when parsing a FEN
+typedef enum
+{
+	feNone,
+	feUnexpectedEnd, 	// The FEN stopped before the en passant target square
+	feUnknownPiece, 	// A character in the piece placement that isn't a piece, digit or '/'
+	feRankTooLong, 	// More than 8 squares in a rank
+	feRankTooShort, 	// A '/' or the end of the piece placement before a rank had 8 squares
+	feTooManyRanks,
+	feTooFewRanks,
+	feExpectedSpace, 	// Fields must be separated by a single space
+	feBadPlayer, 	// The player to move wasn't 'w' or 'b'
+	feBadCastling, 	// The castling rights weren't made of K, Q, k, q and -
+	feBadEpTarget,
+	feBadHalfMoveClock,
+	feBadMoveNumber,
+	feTrailingCharacters 	// Something other than whitespace after the move number
+} fenErrorCode;
+
+typedef struct
+{
+	fenErrorCode code;
+	size_t offset; 	// Byte offset into the FEN where the problem was found
+} fenError;
+
+// Everything boardUnmakeMove needs to take back a move that can't be worked out from the move itself
+typedef struct
+{
+	uint64_t hash;
+	uint8_t captured; 	// The piece on the destination square before the move
+	uint8_t castleState;
+	sq epTarget;
+	uint16_t halfMoveClock;
+	uint16_t moveNumber; 	// Kept because the counters saturate, so it can't always be worked out by counting back
+} undoInfo;
+
+// Initializes the Zobrist keys used for hashing. This is run automatically when the library is loaded if compiled with
+// GCC or Clang; otherwise it must be called once before using anything in chesslib
+void boardInitZobrist();
+
 // Allocates and initializes a board and returns a pointer. Must be freed
 // boardCreateFromFen returns NULL on failure
 board *boardCreate();
 board *boardCreateFromFen(const char *fen);
 
-// Initializes the given board in place. In FromFen: return 0 if successful, 1 if not
+// Initializes the given board in place. In FromFen: return 0 if successful, 1 if not (printing why to stderr)
 void boardInitInPlace(board *b);
+void boardInitEmptyInPlace(board *b);
 uint8_t boardInitFromFenInPlace(board *b, const char *fen);
 
+// Parses at most len bytes of the given FEN into the board, stopping early at a null terminator. Nothing is allocated
+// or printed. Returns 0 if successful, 1 if not and fills in error (if not NULL) with what went wrong and where. The
+// half move clock and move number may be left off, they default to 0 and 1
+uint8_t boardParseFen(board *b, const char *fen, size_t len, fenError *error);
+// Returns a description of the error code. Does not need to be freed
+const char *fenErrorGetStr(fenErrorCode code);
+
 void boardSetPiece(board *b, sq s, piece p);
 piece boardGetPiece(board *b, sq s);
 
+// Returns the Zobrist hash of the position. Two positions have the same hash if they have the same pieces, player to
+// move and castling rights, and the same en passant target square where an en passant capture is actually possible.
+// The counters are not included
+uint64_t boardGetHash(board *b);
+
+// Returns 1 if the current player can legally capture en passant
+uint8_t boardCanCaptureEp(board *b);
+
+// Bitboard getters
+sqSet boardGetOccupied(board *b);
+sqSet boardGetPieceSet(board *b, piece p);
+
+// Returns a key made of the number of each piece on the board, 4 bits per slot of materialCounts (slots 1 to 14,
+// counts above 15 are capped). Boards with the same material have the same key, so it can index endgame tables
+uint64_t boardGetMaterialKey(board *b);
+
+// Returns the square of the given player's king, or SQ_INVALID if they don't have exactly one (only possible with a
+// custom FEN). The bitboards double as piece lists, so this is a single bit scan rather than a search of the board
+sq boardGetKingSquare(board *b, pieceColor player);
+
+// Generates all legal moves. boardGenerateMoves returns a list that must be freed, boardGenerateMovesInto fills the
+// given buffer (clearing it first) and never allocates
 moveList *boardGenerateMoves(board *b);
+void boardGenerateMovesInto(board *b, moveBuffer *buf);
 
+// Generates a subset of the legal moves into the buffer, so a search can look at the likely best moves before the
+// rest are ever generated. Captures includes en passant and every promotion, quiets is everything else (including
+// castling), so between them they give the same moves as boardGenerateMovesInto. Evasions gives all legal moves when
+// the player to move is in check, and nothing otherwise
+void boardGenerateCaptures(board *b, moveBuffer *buf);
+void boardGenerateQuiets(board *b, moveBuffer *buf);
+void boardGenerateEvasions(board *b, moveBuffer *buf);
+
+// Returns 1 if the player to move has any legal move, stopping at the first one found
+uint8_t boardHasLegalMove(board *b);
+// Returns how many legal moves the player to move has, without listing them
+size_t boardCountLegalMoves(board *b);
+
+// Returns 1 if the given move is legal for the player to move, without generating any other moves
+uint8_t boardIsMoveLegal(board *b, move m);
+
+// Returns 1 if the given player attacks the square. Squares occupied by the attacker's own pieces are never attacked
 uint8_t boardIsSquareAttacked(board *b, sq s, pieceColor attacker);
+// Returns the set of the given player's pieces that attack (or defend) the square
+sqSet boardAttackersOf(board *b, sq s, pieceColor attacker);
 uint8_t boardIsInCheck(board *b);
 uint8_t boardIsPlayerInCheck(board *b, pieceColor player);
 
@@ -51,9 +185,20 @@ board *boardPlayMove(board *b, move m);
 // Plays the given move on the given board, modifying the given board in place
 void boardPlayMoveInPlace(board *b, move m);
 
+// Same as boardPlayMoveInPlace, but fills in undo so the move can be taken back with boardUnmakeMove. This lets
+// searches work on one board rather than copying it for every move
+void boardMakeMove(board *b, move m, undoInfo *undo);
+// Takes back the given move, which must be the last move made on the board with boardMakeMove
+void boardUnmakeMove(board *b, move m, const undoInfo *undo);
+
 // Returns if two boards are equal in all ways
 uint8_t boardEq(board *b1, board *b2);
 // Returns if two boards are equal WITHOUT the counters, and filtering the EP target square
 uint8_t boardEqContext(board *b1, board *b2);
 
+// Returns the FEN of the board. Must be freed
 char *boardGetFen(board *b);
+// Writes the FEN of the board into buf, which can hold cap characters including the null terminator. Nothing is
+// allocated. Returns the length of the full FEN; if that's cap or more, it was cut short to fit. A buffer of
+// FEN_MAX_LENGTH characters always fits
+size_t boardWriteFen(board *b, char *buf, size_t cap);
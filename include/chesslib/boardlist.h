@@ -9,27 +9,26 @@
 
 #include "chesslib/board.h"
 
-typedef struct _boardListNode
-{
-	board *board;
-	struct _boardListNode *next;
-} boardListNode;
-
+// A growable array of boards, stored by value one after another. Adding, undoing and getting by index are all O(1)
+// (adding is amortized). Adding can move the boards, so pointers from boardListGet only last until the next add
 typedef struct
 {
-	boardListNode *head;
-	boardListNode *tail;
+	board *boards;
 	size_t size;
+	size_t capacity;
 } boardList;
 
-// Creates an empty boardList/boardListNode with given board
+// Creates an empty boardList
 boardList *boardListCreate();
-boardListNode *boardListNodeCreate(board *b);
 
-// Board list operations
-void boardListAdd(boardList *list, board *b);
+// Board list operations. boardListAddCopy copies the board in and never takes ownership of the one it is given
+void boardListAddCopy(boardList *list, const board *b);
 board *boardListGet(boardList *list, unsigned int index);
 void boardListUndo(boardList *list);
 
-// Frees the boardList and all nodes
+// Adds a copy of the last board and returns it, so the next move can be played on it in place. The list must not be
+// empty
+board *boardListAddNext(boardList *list);
+
+// Frees the boardList and all boards in it
 void boardListFree(boardList *list);
@@ -0,0 +1,65 @@
+/*
+ * Opening book definitions
+ * Reads Polyglot (.bin) opening books: sorted 16 byte entries of a position key, move, weight and learn value, all big
+ * endian
+ */
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "chesslib/board.h"
+#include "chesslib/move.h"
+
+// Polyglot keys are made from a table of 781 random numbers: 768 for pieces on squares, then 4 for castling rights, 8
+// for en passant files and 1 for white to move. Books only match keys made from the same table as the program that
+// wrote them, which for every published book is the Random64 array from the Polyglot source. Passing NULL for the table
+// anywhere below uses that one
+#define BOOK_RANDOM_COUNT 781
+
+extern const uint64_t bookPolyglotRandom[BOOK_RANDOM_COUNT];
+
+#define BOOK_ENTRY_SIZE 16
+
+// One decoded book entry
+typedef struct
+{
+	uint64_t key;
+	move m;
+	uint16_t weight;
+	uint32_t learn;
+} bookEntry;
+
+typedef struct
+{
+	const uint8_t *data; 	// The entries, exactly as they are in the file
+	size_t length; 	// In bytes
+	size_t numEntries;
+	const uint64_t *random; 	// BOOK_RANDOM_COUNT numbers to make keys from
+	uint8_t owned; 	// Whether data was mapped (or read in) by bookOpen, and so must be let go by bookClose
+} book;
+
+// Returns the Polyglot key of the board, made from the given table of BOOK_RANDOM_COUNT numbers (or NULL). Unlike
+// boardGetHash, the en passant file is included whenever a pawn of the player to move stands next to the pawn that
+// just moved, even if capturing would be illegal
+uint64_t bookGetKey(board *b, const uint64_t *random);
+
+// Opens a book file by memory mapping it, so opening is instant and nothing is copied however big the book is.
+// Returns 0 if successful, 1 if not. Must be closed with bookClose
+uint8_t bookOpen(book *bk, const char *path, const uint64_t *random);
+// Uses a book that's already in memory. The data must stay around while the book is used. Nothing is copied
+void bookOpenBuffer(book *bk, const void *data, size_t len, const uint64_t *random);
+void bookClose(book *bk);
+
+// Fills entries with up to max of the entries for the board's position, in the order they are in the book (usually
+// best first), and returns how many there are in total. Entries whose move isn't legal on the board (from a key
+// collision or a broken book) are left out. The book is binary searched, so this takes microseconds for any size
+size_t bookFind(book *bk, board *b, bookEntry *entries, size_t max);
+
+// Returns the book move with the highest weight for the board's position, or a move with both squares SQ_INVALID if
+// the position isn't in the book
+move bookGetBestMove(book *bk, board *b);
+// Returns a book move for the board's position, picked with odds in proportion to the weights. random is any random
+// number, e.g. from rand(), so the caller decides how moves are picked. Same as bookGetBestMove if nothing is found
+move bookGetWeightedMove(book *bk, board *b, uint32_t random);
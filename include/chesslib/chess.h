@@ -23,10 +23,15 @@ typedef enum
 
 typedef struct
 {
+	// The legal moves and terminal state are only worked out when asked for, then kept until the position changes
 	moveList *currentLegalMoves;
+	uint8_t legalMovesKnown;
 	terminalState terminal;
+	uint8_t terminalKnown;
 	boardList *boardHistory;
 	moveList *moveHistory;
+	uint64_t *positionKeys; 	// The hash of each board in boardHistory, for finding repetitions quickly
+	size_t positionKeysCapacity;
 	uint8_t repetitions; 	// How many times we have seen the current position
 } chess;
 
@@ -43,6 +48,8 @@ uint8_t chessInitFenInPlace(chess *c, const char *fen);
 void chessFree(chess *c);
 
 // Getters for game struct
+// NOTE - the history stores boards by value and may move them when it grows, so the pointer from chessGetBoard (and
+// any from boardListGet on the history) is only valid until the next chessPlayMove. Copy the board to keep it longer
 board *chessGetBoard(chess *c);
 moveList *chessGetLegalMoves(chess *c);
 terminalState chessGetTerminalState(chess *c);
@@ -78,5 +85,6 @@ uint8_t chessCanClaimDrawThreefold(chess *c);
 void chessClaimDraw50(chess *c);
 void chessClaimDrawThreefold(chess *c);
 
-// Internal - updates the currentLegalMoves, repetitions, and terminalState fields. Called (interally) every move
+// Internal - updates the repetitions field and marks the legal moves and terminal state as needing to be worked out
+// again. Called (interally) every move
 void chessCalculateFields(chess *c);
@@ -0,0 +1,52 @@
+/*
+ * EPD definitions
+ * Works something out for every position in an EPD or FEN-per-line file, spread over several threads
+ */
+
+#pragma once
+
+#include <stdio.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "chesslib/board.h"
+
+// The most a single result can take up, not including the newline after it
+#define EPD_MAX_RESULT 256
+
+// The most text given to one worker at a time. Smaller inputs are split up finer, so every thread gets some
+#define EPD_CHUNK_SIZE 65536
+
+// What to work out for each position
+typedef enum
+{
+	eoLegalMoves, 	// The number of legal moves
+	eoInCheck, 	// 1 if the player to move is in check, 0 if not
+	eoInsufficientMaterial, 	// 1 if neither player can checkmate, 0 if they can
+	eoPerft, 	// The perft node count to epdOptions.depth
+	eoCallback 	// Whatever epdOptions.callback writes
+} epdOperation;
+
+// Writes the result for one position into out, which has room for cap characters, and returns its length (no
+// newline needed). line is the whole line the position came from, including any EPD operations after it. Called from
+// several threads at once, so anything shared through data must be safe for that
+typedef size_t (*epdCallback)(void *data, board *b, const char *line, size_t len, char *out, size_t cap);
+
+typedef struct
+{
+	epdOperation operation;
+	unsigned int depth; 	// For eoPerft
+	epdCallback callback; 	// For eoCallback
+	void *data; 	// Passed to callback
+	unsigned int numThreads;
+} epdOptions;
+
+// Reads each line of the text as a position and writes one line to out with its result, in the same order as the
+// input. Lines can be full FENs or EPD (four FEN fields, then any operations). Blank lines are skipped, and lines
+// that aren't a valid position get "error: " and the reason. Positions are parsed straight out of the text, into a
+// board on the stack of whichever thread handles them
+void epdProcessBuffer(const char *text, size_t len, const epdOptions *options, FILE *out);
+
+// Same as epdProcessBuffer, but for a file, which is memory mapped rather than read in. Returns 0 if successful, 1 if
+// the file couldn't be opened
+uint8_t epdProcessFile(const char *path, const epdOptions *options, FILE *out);
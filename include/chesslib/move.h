@@ -5,6 +5,8 @@
 
 #pragma once
 
+#include <stddef.h>
+
 #include "chesslib/square.h"
 #include "chesslib/piece.h"
 
@@ -15,11 +17,70 @@ typedef struct
 	pieceType promotion;
 } move;
 
+// A move packed into 16 bits, used wherever lots of moves are stored. Bits 0-5 are the from square index, bits 6-11
+// are the to square index, bits 12-14 are the promotion pieceType and bit 15 is a spare flag. Packed moves compare
+// with ==
+typedef uint16_t packedMove;
+
+#define PACKED_MOVE_FLAG ((packedMove) 0x8000)
+// a1a1, which is never a real move. Moves with a square off the board pack to this
+#define PACKED_MOVE_NONE ((packedMove) 0)
+
 move moveSq(sq from, sq to);
 move movePromote(sq from, sq to, pieceType promotion);
 
 uint8_t moveEq(move m1, move m2);
 
+// Packs a move from square indices (0-63, see sqGetIndex)
+static inline packedMove movePackIndex(uint8_t from, uint8_t to, pieceType promotion)
+{
+	return (packedMove) (from | (to << 6) | (promotion << 12));
+}
+
+static inline uint8_t packedMoveGetFrom(packedMove pm)
+{
+	return pm & 0x3f;
+}
+
+static inline uint8_t packedMoveGetTo(packedMove pm)
+{
+	return (pm >> 6) & 0x3f;
+}
+
+static inline pieceType packedMoveGetPromotion(packedMove pm)
+{
+	return (pieceType) ((pm >> 12) & 0x7);
+}
+
+// Converts to and from the packed form. The spare flag is lost when unpacking
+static inline packedMove movePack(move m)
+{
+	if (m.from.file < 1 || m.from.file > 8 || m.from.rank < 1 || m.from.rank > 8
+			|| m.to.file < 1 || m.to.file > 8 || m.to.rank < 1 || m.to.rank > 8)
+		return PACKED_MOVE_NONE;
+
+	return movePackIndex((m.from.file - 1) + 8 * (m.from.rank - 1), (m.to.file - 1) + 8 * (m.to.rank - 1),
+			m.promotion);
+}
+
+static inline move moveUnpack(packedMove pm)
+{
+	uint8_t from = packedMoveGetFrom(pm);
+	uint8_t to = packedMoveGetTo(pm);
+
+	move m;
+	m.from = (sq) {(from & 7) + 1, (from >> 3) + 1};
+	m.to = (sq) {(to & 7) + 1, (to >> 3) + 1};
+	m.promotion = packedMoveGetPromotion(pm);
+	return m;
+}
+
+// The most space a UCI string written by moveWriteUci can take, including the null terminator
+#define UCI_MAX_LENGTH 6
+
 // Gets the UCI notation for a move. Must be freed
 char *moveGetUci(move m);
+// Writes the UCI notation for a move into buf, which must have room for UCI_MAX_LENGTH characters. Nothing is
+// allocated. Returns the length, not including the null terminator
+size_t moveWriteUci(move m, char *buf);
 move moveFromUci(char *uci);
@@ -0,0 +1,48 @@
+/*
+ * Move buffer definitions
+ * A fixed capacity array of moves, meant to live on the stack so move generation doesn't need to allocate
+ */
+
+#pragma once
+
+#include <stddef.h>
+
+#include "chesslib/move.h"
+#include "chesslib/movelist.h"
+
+// No legal chess position has more than 218 moves
+#define MOVE_BUFFER_CAPACITY 256
+
+typedef struct
+{
+	packedMove moves[MOVE_BUFFER_CAPACITY];
+	size_t size;
+} moveBuffer;
+
+// Move buffer operations. Adding to a full buffer does nothing
+static inline void moveBufferClear(moveBuffer *buf)
+{
+	buf->size = 0;
+}
+
+static inline void moveBufferAddPacked(moveBuffer *buf, packedMove pm)
+{
+	if (buf->size < MOVE_BUFFER_CAPACITY)
+		buf->moves[buf->size++] = pm;
+}
+
+static inline void moveBufferAdd(moveBuffer *buf, move m)
+{
+	moveBufferAddPacked(buf, movePack(m));
+}
+
+static inline move moveBufferGet(moveBuffer *buf, size_t index)
+{
+	return moveUnpack(buf->moves[index]);
+}
+
+// Returns 1 if the move is in the buffer, 0 if not
+uint8_t moveBufferContains(moveBuffer *buf, move m);
+
+// Creates a moveList holding a copy of all moves in the buffer. Must be freed
+moveList *moveBufferToMoveList(moveBuffer *buf);
@@ -9,30 +9,25 @@
 
 #include "chesslib/move.h"
 
-typedef struct _moveListNode
-{
-	move move;
-	struct _moveListNode *next;
-} moveListNode;
-
+// A growable array of moves, stored packed. Adding, undoing and getting by index are all O(1) (adding is amortized)
 typedef struct _moveList
 {
-	moveListNode *head;
-	moveListNode *tail;
+	packedMove *moves;
 	size_t size;
+	size_t capacity;
 } moveList;
 
-// Creates an empty moveList/moveListNode with given move
+// Creates an empty moveList
 moveList *moveListCreate();
-moveListNode *moveListNodeCreate(move move);
 
 // Move list operations
 void moveListAdd(moveList *list, move move);
+void moveListAddPacked(moveList *list, packedMove pm);
 move moveListGet(moveList *list, unsigned int index);
 void moveListUndo(moveList *list);
 
 // Creates a UCI string from the given movelist. Must be freed
 char *moveListGetUciString(moveList *list);
 
-// Frees the movelist and all nodes
+// Frees the movelist
 void moveListFree(moveList *list);
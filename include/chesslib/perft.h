@@ -0,0 +1,23 @@
+/*
+ * Perft definitions
+ * Counts the leaf nodes of the legal move tree, for verifying and benchmarking move generation
+ */
+
+#pragma once
+
+#include <stdint.h>
+
+#include "chesslib/board.h"
+#include "chesslib/movebuffer.h"
+
+// Returns the number of leaf nodes of the legal move tree of the given depth. The board is not modified
+uint64_t perft(board *b, unsigned int depth);
+
+// Same as perft, but also splits the count up by root move. moves is filled with the legal moves of the given board,
+// and counts[i] is set to the number of leaf nodes below moves->moves[i]. Returns the total
+uint64_t perftDivide(board *b, unsigned int depth, moveBuffer *moves, uint64_t counts[MOVE_BUFFER_CAPACITY]);
+
+// Same as perft, but counts in parallel. The tree is split into the positions splitDepth plies below the root, which
+// are counted by a pool of numThreads threads. Idle threads steal positions from busy ones, so uneven subtrees don't
+// leave threads waiting. Falls back to perft if there is nothing to split
+uint64_t perftParallel(board *b, unsigned int depth, unsigned int numThreads, unsigned int splitDepth);
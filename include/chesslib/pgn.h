@@ -0,0 +1,96 @@
+/*
+ * PGN definitions
+ * Streams games out of PGN text, replaying each one on a board as it goes
+ */
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "chesslib/board.h"
+#include "chesslib/move.h"
+
+// Space kept for a tag name, tag value and movetext token, including the null terminator. Longer ones are cut short
+// (a movetext token that long can't be a move, so it is treated as a bad move)
+#define PGN_MAX_TAG_NAME 64
+#define PGN_MAX_TAG_VALUE 256
+#define PGN_MAX_TOKEN 32
+
+// How much pgnReadFd reads at a time
+#define PGN_READ_CHUNK 65536
+
+// What went wrong in a game. Once a game has an error the rest of its moves are skipped
+typedef enum
+{
+	peNone,
+	peBadMove, 	// A move that couldn't be read, or isn't legal in the position
+	peBadFen 	// The FEN tag couldn't be parsed
+} pgnErrorCode;
+
+// Called for each tag pair as it is read. name and value are only valid during the call
+typedef void (*pgnTagCallback)(void *data, const char *name, const char *value);
+// Called after each move is played. b is the position after the move, and ply counts the moves of the game from 1
+typedef void (*pgnMoveCallback)(void *data, board *b, move m, unsigned int ply);
+// Called at the end of each game with the final position. result is "1-0", "0-1", "1/2-1/2" or "*" (also used when
+// a game ends without a result)
+typedef void (*pgnGameCallback)(void *data, board *b, const char *result, unsigned int plies, pgnErrorCode error);
+
+// Any of the callbacks may be NULL. data is passed to each of them
+typedef struct
+{
+	pgnTagCallback onTag;
+	pgnMoveCallback onMove;
+	pgnGameCallback onGameEnd;
+	void *data;
+} pgnCallbacks;
+
+// Where the reader is in the text
+typedef enum
+{
+	psBetween, 	// Between tokens
+	psToken, 	// In a movetext token
+	psTagName,
+	psTagBeforeValue,
+	psTagValue,
+	psTagValueEscape, 	// Just after a backslash in a tag value
+	psTagEnd, 	// Between a tag value and the closing ']'
+	psComment, 	// In a {} comment
+	psRestOfLine, 	// In a ; comment or a % escaped line
+	psVariation 	// In a () variation, which is skipped
+} pgnState;
+
+// Reads PGN text fed to it in pieces of any size, so games can be read straight out of a file or socket. Only one
+// game is held at a time, on a single board, and nothing is allocated
+typedef struct
+{
+	pgnCallbacks callbacks;
+	board b;
+	unsigned int ply;
+	pgnErrorCode error;
+	uint8_t inGame; 	// Whether anything of the current game has been read yet
+	uint8_t inMovetext; 	// Whether any of the current game's movetext has been read yet
+	uint8_t lineStart; 	// Whether the next character starts a line, for % escapes
+	uint8_t state; 	// A pgnState
+	uint8_t returnState; 	// The pgnState to go back to at the end of a comment
+	unsigned int variationDepth;
+	char name[PGN_MAX_TAG_NAME];
+	size_t nameLength;
+	char value[PGN_MAX_TAG_VALUE];
+	size_t valueLength;
+	char token[PGN_MAX_TOKEN];
+	size_t tokenLength;
+	uint64_t games; 	// How many games have been finished
+} pgnReader;
+
+// Initializes the reader, ready for the start of the text
+void pgnReaderInit(pgnReader *r, const pgnCallbacks *callbacks);
+// Reads the next len bytes of the text. Games, tags and moves can be split between calls anywhere
+void pgnReaderFeed(pgnReader *r, const char *text, size_t len);
+// Marks the end of the text, finishing the last game if it had no result
+void pgnReaderFinish(pgnReader *r);
+
+// Reads every game out of a buffer or file descriptor (until the end of the file or a read error). Returns the number
+// of games read
+uint64_t pgnReadBuffer(const char *text, size_t len, const pgnCallbacks *callbacks);
+uint64_t pgnReadFd(int fd, const pgnCallbacks *callbacks);
@@ -8,6 +8,11 @@
 
 #include "chesslib/board.h"
 #include "chesslib/movelist.h"
+#include "chesslib/squareset.h"
+
+// Initializes the attack tables used below. This is run automatically when the library is loaded if compiled with
+// GCC or Clang; otherwise it must be called once before using anything in chesslib
+void pmInit();
 
 // Returns a list for a generic piece type
 
@@ -30,3 +35,18 @@ moveList *pmGetKingMoves(board *b, sq s);
 
 // Pawns are special...
 moveList *pmGetPawnAttacks(board *b, sq s);
+
+// Attack sets - each of these return the set of squares that a piece on the given square index (0-63) attacks,
+// regardless of what is standing on those squares. Sliders are blocked by the given set of occupied squares.
+// These are all table lookups
+sqSet pmGetPawnAttackSet(uint8_t index, pieceColor color);
+sqSet pmGetKnightAttackSet(uint8_t index);
+sqSet pmGetBishopAttackSet(uint8_t index, sqSet occupied);
+sqSet pmGetRookAttackSet(uint8_t index, sqSet occupied);
+sqSet pmGetQueenAttackSet(uint8_t index, sqSet occupied);
+sqSet pmGetKingAttackSet(uint8_t index);
+
+// Returns the squares strictly between the two given squares if they share a rank, file or diagonal, otherwise empty
+sqSet pmGetBetweenSet(uint8_t index1, uint8_t index2);
+// Returns the entire rank, file or diagonal going through both given squares, or empty if they don't share one
+sqSet pmGetLineSet(uint8_t index1, uint8_t index2);
@@ -0,0 +1,23 @@
+/*
+ * SAN definitions
+ * These need the board to work out, so they live here rather than in move.h to avoid circular dependencies
+ */
+
+#pragma once
+
+#include <stddef.h>
+
+#include "chesslib/board.h"
+#include "chesslib/move.h"
+
+// The most space a SAN string written by moveToSan can take, including the null terminator (e.g. "Qa1xb2#")
+#define SAN_MAX_LENGTH 8
+
+// Writes the SAN of the given legal move into buf, which must have room for SAN_MAX_LENGTH characters. Nothing is
+// allocated. Returns the length, not including the null terminator
+size_t moveToSan(board *b, move m, char *buf);
+
+// Returns the legal move the SAN string stands for. Check marks and annotations (+, #, !, ?) are ignored, and castling
+// can be written with O's or zeros. If it isn't exactly one legal move, both squares of the returned move are
+// SQ_INVALID
+move moveFromSan(board *b, const char *san);
@@ -11,5 +11,48 @@
 // TODO - add conditional typedefs to let systems that don't support uint64_t to use a struct of 8 bytes or something
 typedef uint64_t sqSet;
 
+// All dark squares (a1 is dark)
+#define SQSET_DARK ((sqSet) 0xAA55AA55AA55AA55)
+
 void sqSetSet(sqSet *ss, sq s, uint8_t value);
 uint8_t sqSetGet(sqSet *ss, sq s);
+
+// Bit twiddling helpers for iterating over sets. These are used in the hottest loops of the library, so they are
+// defined inline here rather than in squareset.c
+
+// Returns the number of squares in the set
+static inline uint8_t sqSetCount(sqSet ss)
+{
+#if defined(__GNUC__)
+	return __builtin_popcountll(ss);
+#else
+	uint8_t count = 0;
+	for (; ss; ss &= ss - 1)
+		count++;
+	return count;
+#endif
+}
+
+// Returns the index (0-63) of the lowest square in the set. The set must not be empty
+static inline uint8_t sqSetLsb(sqSet ss)
+{
+#if defined(__GNUC__)
+	return __builtin_ctzll(ss);
+#else
+	uint8_t index = 0;
+	while (!(ss & 1))
+	{
+		ss >>= 1;
+		index++;
+	}
+	return index;
+#endif
+}
+
+// Removes the lowest square from the set and returns its index (0-63). The set must not be empty
+static inline uint8_t sqSetPopLsb(sqSet *ss)
+{
+	uint8_t index = sqSetLsb(*ss);
+	*ss &= *ss - 1;
+	return index;
+}
@@ -11,6 +11,86 @@
 #include "chesslib/board.h"
 #include "chesslib/piecemoves.h"
 
+/////////////
+// ZOBRIST //
+/////////////
+
+uint64_t zobristPieces[13][64]; 	// The pEmpty row is all zeros
+uint64_t zobristCastle[16]; 	// Indexed by castleState
+uint64_t zobristEpFile[8];
+uint64_t zobristBlackToMove;
+
+#if defined(__GNUC__)
+__attribute__((constructor))
+#endif
+void boardInitZobrist()
+{
+	// xorshift64*, with a fixed seed so hashes are the same every run
+	uint64_t state = 1070372;
+	uint64_t keys[13 * 64 + 4 + 8 + 1];
+
+	for (int i = 0; i < sizeof(keys) / sizeof(keys[0]); i++)
+	{
+		state ^= state >> 12;
+		state ^= state << 25;
+		state ^= state >> 27;
+		keys[i] = state * 2685821657736338717ULL;
+	}
+
+	uint64_t *key = keys;
+
+	for (int i = 0; i < 64; i++)
+		zobristPieces[pEmpty][i] = 0;
+	for (piece p = pWPawn; p <= pBKing; p++)
+		for (int i = 0; i < 64; i++)
+			zobristPieces[p][i] = *key++;
+
+	// Each castling right gets a key, and each castle state is the combination of its rights
+	uint64_t castleKeys[4] = {key[0], key[1], key[2], key[3]};
+	key += 4;
+	for (int state = 0; state < 16; state++)
+	{
+		zobristCastle[state] = 0;
+		for (int right = 0; right < 4; right++)
+		{
+			if (state & (1 << right))
+				zobristCastle[state] ^= castleKeys[right];
+		}
+	}
+
+	for (int i = 0; i < 8; i++)
+		zobristEpFile[i] = *key++;
+
+	zobristBlackToMove = *key++;
+}
+
+// HELPER FUNCTION:
+// Returns the part of the hash that depends on the en passant target square
+uint64_t boardGetEpHash(board *b)
+{
+	if (!boardCanCaptureEp(b))
+		return 0;
+
+	return zobristEpFile[b->epTarget.file - 1];
+}
+
+// HELPER FUNCTION:
+// Returns the part of the hash for the castling rights, en passant target and player to move
+uint64_t boardGetStateHash(board *b)
+{
+	uint64_t hash = zobristCastle[b->castleState & 0xF] ^ boardGetEpHash(b);
+
+	if (b->currentPlayer == pcBlack)
+		hash ^= zobristBlackToMove;
+
+	return hash;
+}
+
+
+///////////
+// BOARD //
+///////////
+
 board *boardCreate()
 {
 	return boardCreateFromFen(INITIAL_FEN);
@@ -34,451 +114,1157 @@ void boardInitInPlace(board *b)
 	boardInitFromFenInPlace(b, INITIAL_FEN);
 }
 
+// Initializes a board with no pieces on it, white to play
+void boardInitEmptyInPlace(board *b)
+{
+	// pEmpty is 0, so a zeroed byte is two empty squares
+	for (int i = 0; i < 32; i++)
+		b->packedPieces[i] = 0;
+
+	for (int i = 0; i < 6; i++)
+		b->typeSets[i] = 0;
+	for (int i = 0; i < 2; i++)
+		b->colorSets[i] = 0;
+
+	for (int i = 0; i < MATERIAL_SLOTS; i++)
+		b->materialCounts[i] = 0;
+	b->materialCounts[pEmpty] = 64;
+
+	b->currentPlayer = pcWhite;
+	b->castleState = 0;
+	b->epTarget = SQ_INVALID;
+	b->halfMoveClock = 0;
+	b->moveNumber = 1;
+
+	b->hash = 0;
+}
+
 uint8_t boardInitFromFenInPlace(board *b, const char *fen)
 {
-	sq currSq = sqI(1, 8);
+	fenError error;
+	if (boardParseFen(b, fen, strlen(fen), &error))
+	{
+		fprintf(stderr, "ERROR IN FEN: %s at character %zu\n", fenErrorGetStr(error.code), error.offset);
+		return 1;
+	}
 
-	char c;
+	return 0;
+}
 
-	// Read in pieces
+// HELPER FUNCTION:
+// Records the given error, if there's somewhere to put it. Always returns 1 so it can be returned directly
+uint8_t boardSetFenError(fenError *error, fenErrorCode code, size_t offset)
+{
+	if (error)
+	{
+		error->code = code;
+		error->offset = offset;
+	}
+	return 1;
+}
 
-	while ((c = *fen))
+// HELPER FUNCTION:
+// Reads an unsigned number starting at *i, leaving *i just past it. Numbers too big for 16 bits are capped, no real
+// game gets anywhere near that. Returns 0 if successful, 1 if there wasn't a digit
+uint8_t boardParseFenCounter(const char *fen, size_t len, size_t *i, uint16_t *counter)
+{
+	if (*i >= len || fen[*i] < '0' || fen[*i] > '9')
+		return 1;
+
+	uint32_t value = 0;
+	while (*i < len && fen[*i] >= '0' && fen[*i] <= '9')
 	{
-		if (c == ' ')
+		value = value * 10 + (fen[*i] - '0');
+		if (value > UINT16_MAX)
+			value = UINT16_MAX;
+		(*i)++;
+	}
+
+	*counter = value;
+	return 0;
+}
+
+uint8_t boardParseFen(board *b, const char *fen, size_t len, fenError *error)
+{
+	// Treat a null terminator as the end, so callers can pass a bound that's bigger than the string
+	for (size_t n = 0; n < len; n++)
+	{
+		if (fen[n] == 0)
 		{
+			len = n;
 			break;
 		}
-		else if (c >= '1' && c <= '8')
+	}
+
+	boardInitEmptyInPlace(b);
+
+	size_t i = 0;
+	uint8_t file = 1;
+	uint8_t rank = 8;
+
+	// Read in pieces
+	for (; i < len && fen[i] != ' '; i++)
+	{
+		char c = fen[i];
+
+		if (c >= '1' && c <= '8')
 		{
-			int num = c - '0';
-			if (currSq.file + num > 9)
-			{
-				fprintf(stderr, "ERROR IN FEN: Spacer put file over the end\n");
-				return 1;
-			}
-			for (int i = 0; i < num; i++)
-			{
-				boardSetPiece(b, currSq, pEmpty);
-				currSq.file++;
-			}
+			file += c - '0';
+			if (file > 9)
+				return boardSetFenError(error, feRankTooLong, i);
+			continue;
 		}
-		else if (c == '/')
+
+		if (c == '/')
 		{
-			if (currSq.file != 9)
-			{
-				fprintf(stderr, "ERROR IN FEN: Found '/' at wrong position in rank\n");
-				return 1;
-			}
-			if (currSq.rank <= 1)
-			{
-				fprintf(stderr, "ERROR IN FEN: Found '/' after the last rank\n");
-				return 1;
-			}
-			currSq.file = 1;
-			currSq.rank--;
+			if (file != 9)
+				return boardSetFenError(error, feRankTooShort, i);
+			if (rank <= 1)
+				return boardSetFenError(error, feTooManyRanks, i);
+			file = 1;
+			rank--;
+			continue;
 		}
-		else
-		{
-			if (currSq.file > 8)
-			{
-				fprintf(stderr, "ERROR IN FEN: Found character '%c' after the end of a rank\n", c);
-				return 1;
-			}
-
-			char lc = tolower(c);
-			int isBlack = islower(c);
-
-			switch (lc)
-			{
-				case 'p':
-					boardSetPiece(b, currSq, isBlack ? pBPawn : pWPawn);
-					break;
 
-				case 'n':
-					boardSetPiece(b, currSq, isBlack ? pBKnight : pWKnight);
-					break;
+		pieceType pt;
+		switch (tolower(c))
+		{
+			case 'p':
+				pt = ptPawn;
+				break;
 
-				case 'b':
-					boardSetPiece(b, currSq, isBlack ? pBBishop : pWBishop);
-					break;
+			case 'n':
+				pt = ptKnight;
+				break;
 
-				case 'r':
-					boardSetPiece(b, currSq, isBlack ? pBRook : pWRook);
-					break;
+			case 'b':
+				pt = ptBishop;
+				break;
 
-				case 'q':
-					boardSetPiece(b, currSq, isBlack ? pBQueen : pWQueen);
-					break;
+			case 'r':
+				pt = ptRook;
+				break;
 
-				case 'k':
-					boardSetPiece(b, currSq, isBlack ? pBKing : pWKing);
-					break;
+			case 'q':
+				pt = ptQueen;
+				break;
 
-				default:
-					fprintf(stderr, "ERROR IN FEN: Unknown character '%c'\n", c);
-					return 1;
-			}
+			case 'k':
+				pt = ptKing;
+				break;
 
-			currSq.file++;
+			default:
+				return boardSetFenError(error, feUnknownPiece, i);
 		}
 
-		fen++;
-	}
+		if (file > 8)
+			return boardSetFenError(error, feRankTooLong, i);
 
-	if ((currSq.rank != 1) || (currSq.file != 9))
-	{
-		fprintf(stderr, "ERROR IN FEN: Ended prematurely\n");
-		return 1;
+		boardSetPiece(b, sqI(file, rank), pieceMake(pt, islower(c) ? pcBlack : pcWhite));
+		file++;
 	}
 
-	fen++; 	// Go past the last space
+	if (file != 9)
+		return boardSetFenError(error, i < len ? feRankTooShort : feUnexpectedEnd, i);
+	if (rank != 1)
+		return boardSetFenError(error, i < len ? feTooFewRanks : feUnexpectedEnd, i);
 
 	// Read in whose turn it is
+	if (i >= len || ++i >= len)
+		return boardSetFenError(error, feUnexpectedEnd, i);
 
-	c = *fen;
-	switch (c)
-	{
-		case 'w':
-			b->currentPlayer = pcWhite;
-			break;
-		case 'b':
-			b->currentPlayer = pcBlack;
-			break;
-		default:
-			fprintf(stderr, "ERROR IN FEN: Expected 'w' or 'b', found '%c'\n", c);
-			return 1;
-	}
-	fen++;
+	if (fen[i] == 'w')
+		b->currentPlayer = pcWhite;
+	else if (fen[i] == 'b')
+		b->currentPlayer = pcBlack;
+	else
+		return boardSetFenError(error, feBadPlayer, i);
 
-	c = *fen;
-	if (c != ' ')
-	{
-		fprintf(stderr, "ERROR IN FEN: Expected ' ' after w/b, found '%c'\n", c);
-		return 1;
-	}
-	fen++;
+	if (++i >= len)
+		return boardSetFenError(error, feUnexpectedEnd, i);
+	if (fen[i] != ' ')
+		return boardSetFenError(error, feExpectedSpace, i);
 
 	// Read in castling state
 	// NOTE: technically this can match abnormal sequences, but it will match all correct sequences
 	// Ex: 'kqqqQQ--k' will function the same as 'Qkq'. This is fine by me
+	// Rights are only kept if the king and rook are actually there
+	if (++i >= len)
+		return boardSetFenError(error, feUnexpectedEnd, i);
+	if (fen[i] == ' ')
+		return boardSetFenError(error, feBadCastling, i);
 
-	b->castleState = 0;
-
-	c = *fen;
-	while ((c = *fen))
+	for (; i < len && fen[i] != ' '; i++)
 	{
-		if (c == ' ')
-			break;
-
-		switch (c)
+		switch (fen[i])
 		{
 			case '-':
 				// Nothing needs to be done
 				break;
 
 			case 'K':
-				if (boardGetPiece(b, sqI(5, 1)) == pWKing && boardGetPiece(b, sqI(8, 1)) == pWRook)
+				if (boardGetPieceAt(b, 4) == pWKing && boardGetPieceAt(b, 7) == pWRook)
 					b->castleState |= CASTLE_WK;
 				break;
 
 			case 'Q':
-				if (boardGetPiece(b, sqI(5, 1)) == pWKing && boardGetPiece(b, sqI(1, 1)) == pWRook)
+				if (boardGetPieceAt(b, 4) == pWKing && boardGetPieceAt(b, 0) == pWRook)
 					b->castleState |= CASTLE_WQ;
 				break;
 
 			case 'k':
-				if (boardGetPiece(b, sqI(5, 8)) == pBKing && boardGetPiece(b, sqI(8, 8)) == pBRook)
+				if (boardGetPieceAt(b, 60) == pBKing && boardGetPieceAt(b, 63) == pBRook)
 					b->castleState |= CASTLE_BK;
 				break;
 
 			case 'q':
-				if (boardGetPiece(b, sqI(5, 8)) == pBKing && boardGetPiece(b, sqI(1, 8)) == pBRook)
+				if (boardGetPieceAt(b, 60) == pBKing && boardGetPieceAt(b, 56) == pBRook)
 					b->castleState |= CASTLE_BQ;
 				break;
 
 			default:
-				fprintf(stderr, "ERROR IN FEN: Expected K/Q/k/q or -, found '%c'\n", c);
-				return 1;
+				return boardSetFenError(error, feBadCastling, i);
+		}
+	}
+
+	// Read in the en passant target square
+	if (i >= len || ++i >= len)
+		return boardSetFenError(error, feUnexpectedEnd, i);
+
+	if (fen[i] == '-')
+	{
+		i++;
+	}
+	else
+	{
+		if (i + 1 >= len || fen[i] < 'a' || fen[i] > 'h' || fen[i + 1] < '1' || fen[i + 1] > '8')
+			return boardSetFenError(error, feBadEpTarget, i);
+
+		b->epTarget = sqI(fen[i] - 'a' + 1, fen[i + 1] - '0');
+		i += 2;
+	}
+
+	// Read in half move clock and full move count, if they're there
+	if (i < len && fen[i] == ' ' && i + 1 < len && fen[i + 1] != ' ')
+	{
+		i++;
+		if (boardParseFenCounter(fen, len, &i, &b->halfMoveClock))
+			return boardSetFenError(error, feBadHalfMoveClock, i);
+
+		if (i < len && fen[i] == ' ' && i + 1 < len && fen[i + 1] != ' ')
+		{
+			i++;
+			if (boardParseFenCounter(fen, len, &i, &b->moveNumber))
+				return boardSetFenError(error, feBadMoveNumber, i);
+		}
+	}
+
+	// Allow trailing whitespace, like a newline from reading a line of a file
+	for (; i < len; i++)
+	{
+		if (fen[i] != ' ' && fen[i] != '\t' && fen[i] != '\r' && fen[i] != '\n')
+			return boardSetFenError(error, feTrailingCharacters, i);
+	}
+
+	// The pieces are already hashed by boardSetPiece
+	b->hash ^= boardGetStateHash(b);
+
+	if (error)
+	{
+		error->code = feNone;
+		error->offset = i;
+	}
+
+	return 0;
+}
+
+const char *fenErrorGetStr(fenErrorCode code)
+{
+	switch (code)
+	{
+		case feNone:
+			return "No error";
+
+		case feUnexpectedEnd:
+			return "Ended prematurely";
+
+		case feUnknownPiece:
+			return "Unknown piece";
+
+		case feRankTooLong:
+			return "Too many squares in rank";
+
+		case feRankTooShort:
+			return "Too few squares in rank";
+
+		case feTooManyRanks:
+			return "Too many ranks";
+
+		case feTooFewRanks:
+			return "Too few ranks";
+
+		case feExpectedSpace:
+			return "Expected ' '";
+
+		case feBadPlayer:
+			return "Expected 'w' or 'b'";
+
+		case feBadCastling:
+			return "Expected K/Q/k/q or -";
+
+		case feBadEpTarget:
+			return "Invalid EP target square";
+
+		case feBadHalfMoveClock:
+			return "Invalid half move clock";
+
+		case feBadMoveNumber:
+			return "Invalid move number";
+
+		case feTrailingCharacters:
+			return "Unexpected characters after the move number";
+	}
+	return "Unknown error";
+}
+
+// The slot of materialCounts each piece is counted in, on a light square and on a dark square
+const uint8_t materialSlots[2][13] =
+{
+	{pEmpty, pWPawn, pWKnight, pWBishop, pWRook, pWQueen, pWKing, pBPawn, pBKnight, pBBishop, pBRook, pBQueen, pBKing},
+	{pEmpty, pWPawn, pWKnight, MATERIAL_W_DARK_BISHOP, pWRook, pWQueen, pWKing,
+			pBPawn, pBKnight, MATERIAL_B_DARK_BISHOP, pBRook, pBQueen, pBKing},
+};
+
+void boardSetPiece(board *b, sq s, piece p)
+{
+	int index = sqGetIndex(s);
+	sqSet bit = (sqSet) 1 << index;
+
+	// Whether en passant can be captured might change, and that's part of the hash
+	uint8_t hasEp = !sqEq(b->epTarget, SQ_INVALID);
+	if (hasEp)
+		b->hash ^= boardGetEpHash(b);
+
+	// Take the old piece out of the bitboards, and put the new one in
+	piece old = boardGetPieceAt(b, index);
+	b->hash ^= zobristPieces[old][index] ^ zobristPieces[p][index];
+	if (old != pEmpty)
+	{
+		b->typeSets[pieceGetType(old) - 1] &= ~bit;
+		b->colorSets[pieceGetColor(old) - 1] &= ~bit;
+	}
+	if (p != pEmpty)
+	{
+		b->typeSets[pieceGetType(p) - 1] |= bit;
+		b->colorSets[pieceGetColor(p) - 1] |= bit;
+	}
+
+	uint8_t dark = (SQSET_DARK >> index) & 1;
+	b->materialCounts[materialSlots[dark][old]]--;
+	b->materialCounts[materialSlots[dark][p]]++;
+
+	uint8_t shift = (index & 1) << 2;
+	b->packedPieces[index >> 1] = (b->packedPieces[index >> 1] & ~(0xF << shift)) | (p << shift);
+
+	if (hasEp)
+		b->hash ^= boardGetEpHash(b);
+}
+
+piece boardGetPiece(board *b, sq s)
+{
+	int index = sqGetIndex(s);
+	return boardGetPieceAt(b, index);
+}
+
+uint64_t boardGetHash(board *b)
+{
+	return b->hash;
+}
+
+uint64_t boardGetMaterialKey(board *b)
+{
+	uint64_t key = 0;
+	for (int i = 1; i <= MATERIAL_B_DARK_BISHOP; i++)
+	{
+		uint64_t count = b->materialCounts[i] > 15 ? 15 : b->materialCounts[i];
+		key |= count << (4 * i);
+	}
+	return key;
+}
+
+sqSet boardGetOccupied(board *b)
+{
+	return b->colorSets[0] | b->colorSets[1];
+}
+
+sqSet boardGetPieceSet(board *b, piece p)
+{
+	if (p == pEmpty)
+		return ~boardGetOccupied(b);
+
+	return boardGetTypeSet(b, pieceGetType(p)) & boardGetColorSet(b, pieceGetColor(p));
+}
+
+// HELPER FUNCTION:
+// Returns the index of the given player's king, or 64 if they don't have exactly one
+uint8_t boardGetKingIndex(board *b, pieceColor player)
+{
+	sqSet kings = boardGetTypeSet(b, ptKing) & boardGetColorSet(b, player);
+	if (!kings || (kings & (kings - 1)))
+		return 64;
+
+	return sqSetLsb(kings);
+}
+
+sq boardGetKingSquare(board *b, pieceColor player)
+{
+	uint8_t kingIndex = boardGetKingIndex(b, player);
+	return kingIndex < 64 ? sqIndex(kingIndex) : SQ_INVALID;
+}
+
+// Generates a list of all legal moves. This list must be freed with freeMoveList
+moveList *boardGenerateMoves(board *b)
+{
+	moveBuffer buf;
+	boardGenerateMovesInto(b, &buf);
+	return moveBufferToMoveList(&buf);
+}
+
+// Which moves the legal move generator should produce. Between them, the two stages cover every move exactly once
+#define GEN_CAPTURES 0b01 	// Captures, including en passant, and all promotions
+#define GEN_QUIETS 0b10 	// Everything else, including castling
+#define GEN_ALL (GEN_CAPTURES | GEN_QUIETS)
+
+// HELPER FUNCTION:
+// Returns the set of pieces of both colors that attack the given square, if the given squares were occupied
+sqSet boardGetAttackersTo(board *b, uint8_t index, sqSet occupied)
+{
+	sqSet queens = boardGetTypeSet(b, ptQueen);
+
+	return (pmGetPawnAttackSet(index, pcWhite) & boardGetTypeSet(b, ptPawn) & boardGetColorSet(b, pcBlack))
+			| (pmGetPawnAttackSet(index, pcBlack) & boardGetTypeSet(b, ptPawn) & boardGetColorSet(b, pcWhite))
+			| (pmGetKnightAttackSet(index) & boardGetTypeSet(b, ptKnight))
+			| (pmGetBishopAttackSet(index, occupied) & (boardGetTypeSet(b, ptBishop) | queens))
+			| (pmGetRookAttackSet(index, occupied) & (boardGetTypeSet(b, ptRook) | queens))
+			| (pmGetKingAttackSet(index) & boardGetTypeSet(b, ptKing));
+}
+
+// HELPER FUNCTION:
+// Adds a pawn move to the buffer, adding all four promotions if it lands on the last rank
+void boardAddPawnMove(moveBuffer *buf, uint8_t from, uint8_t to)
+{
+	if (to < 8 || to >= 56)
+	{
+		moveBufferAddPacked(buf, movePackIndex(from, to, ptQueen));
+		moveBufferAddPacked(buf, movePackIndex(from, to, ptRook));
+		moveBufferAddPacked(buf, movePackIndex(from, to, ptBishop));
+		moveBufferAddPacked(buf, movePackIndex(from, to, ptKnight));
+	}
+	else
+	{
+		moveBufferAddPacked(buf, movePackIndex(from, to, ptEmpty));
+	}
+}
+
+// HELPER FUNCTION:
+// Adds the castling moves for the current player to the buffer, if they are legal
+void boardAddCastlingMoves(board *b, moveBuffer *buf)
+{
+	// Can we castle?
+	uint8_t castleOO = b->currentPlayer == pcWhite ? (b->castleState & CASTLE_WK) : (b->castleState & CASTLE_BK);
+	uint8_t castleOOO = b->currentPlayer == pcWhite ? (b->castleState & CASTLE_WQ) : (b->castleState & CASTLE_BQ);
+
+	if (castleOO || castleOOO)
+	{
+		uint8_t castleRank = b->currentPlayer == pcWhite ? 1 : 8;
+		pieceColor attacker = b->currentPlayer == pcWhite ? pcBlack : pcWhite;
+
+		piece ourKing = b->currentPlayer == pcWhite ? pWKing : pBKing;
+		piece ourRook = b->currentPlayer == pcWhite ? pWRook : pBRook;
+
+		if (castleOO)
+		{
+			if (boardGetPiece(b, sqI(5, castleRank)) == ourKing
+					&& boardGetPiece(b, sqI(8, castleRank)) == ourRook
+					&& boardGetPiece(b, sqI(6, castleRank)) == pEmpty
+					&& boardGetPiece(b, sqI(7, castleRank)) == pEmpty
+					&& !boardIsSquareAttacked(b, sqI(5, castleRank), attacker)
+					&& !boardIsSquareAttacked(b, sqI(6, castleRank), attacker)
+					&& !boardIsSquareAttacked(b, sqI(7, castleRank), attacker))
+				moveBufferAdd(buf, moveSq(sqI(5, castleRank), sqI(7, castleRank)));
+		}
+
+		if (castleOOO)
+		{
+			if (boardGetPiece(b, sqI(5, castleRank)) == ourKing
+					&& boardGetPiece(b, sqI(1, castleRank)) == ourRook
+					&& boardGetPiece(b, sqI(4, castleRank)) == pEmpty
+					&& boardGetPiece(b, sqI(3, castleRank)) == pEmpty
+					&& boardGetPiece(b, sqI(2, castleRank)) == pEmpty
+					&& !boardIsSquareAttacked(b, sqI(5, castleRank), attacker)
+					&& !boardIsSquareAttacked(b, sqI(4, castleRank), attacker)
+					&& !boardIsSquareAttacked(b, sqI(3, castleRank), attacker))
+				moveBufferAdd(buf, moveSq(sqI(5, castleRank), sqI(3, castleRank)));
+		}
+	}
+}
+
+// HELPER FUNCTION:
+// Generates all moves without checking whether they leave the king in check. Castling moves are still fully checked
+void boardGeneratePseudoLegalMoves(board *b, moveBuffer *buf)
+{
+	moveBufferClear(buf);
+
+	sqSet occupied = boardGetOccupied(b);
+	sqSet ours = boardGetColorSet(b, b->currentPlayer);
+	sqSet empty = ~occupied;
+	sqSet epSet = sqEq(b->epTarget, SQ_INVALID) ? 0 : (sqSet) 1 << sqGetIndex(b->epTarget);
+	sqSet captureTargets = (occupied & ~ours) | epSet;
+
+	int8_t pawnDelta = b->currentPlayer == pcWhite ? 8 : -8;
+
+	sqSet pieces = ours;
+	while (pieces)
+	{
+		uint8_t i = sqSetPopLsb(&pieces);
+		sqSet targets;
+
+		switch (pieceGetType(boardGetPieceAt(b, i)))
+		{
+			case ptPawn:
+			{
+				// Forward moves
+				uint8_t to = i + pawnDelta;
+				if (to < 64 && ((empty >> to) & 1))
+				{
+					boardAddPawnMove(buf, i, to);
+
+					// Can this piece move two squares?
+					to += pawnDelta;
+					if ((b->currentPlayer == pcWhite ? (i < 16) : (i >= 48)) && ((empty >> to) & 1))
+						boardAddPawnMove(buf, i, to);
+				}
+
+				// Captures
+				targets = pmGetPawnAttackSet(i, b->currentPlayer) & captureTargets;
+				while (targets)
+					boardAddPawnMove(buf, i, sqSetPopLsb(&targets));
+
+				continue;
+			}
+
+			case ptKnight:
+				targets = pmGetKnightAttackSet(i);
+				break;
+
+			case ptBishop:
+				targets = pmGetBishopAttackSet(i, occupied);
+				break;
+
+			case ptRook:
+				targets = pmGetRookAttackSet(i, occupied);
+				break;
+
+			case ptQueen:
+				targets = pmGetQueenAttackSet(i, occupied);
+				break;
+
+			case ptKing:
+				targets = pmGetKingAttackSet(i);
+				break;
+
+			default:
+				targets = 0;
+				break;
+		}
+
+		targets &= ~ours;
+		while (targets)
+			moveBufferAddPacked(buf, movePackIndex(i, sqSetPopLsb(&targets), ptEmpty));
+	}
+
+	boardAddCastlingMoves(b, buf);
+}
+
+// HELPER FUNCTION:
+// Returns the set of our pieces that are pinned to our king on the given square. A piece is pinned if it's the only
+// thing standing between our king and one of their sliders
+sqSet boardGetPinned(board *b, uint8_t kingIndex, sqSet ours, sqSet theirs)
+{
+	sqSet occupied = ours | theirs;
+	sqSet pinned = 0;
+	sqSet queens = boardGetTypeSet(b, ptQueen);
+	sqSet snipers = (pmGetBishopAttackSet(kingIndex, 0) & (boardGetTypeSet(b, ptBishop) | queens))
+			| (pmGetRookAttackSet(kingIndex, 0) & (boardGetTypeSet(b, ptRook) | queens));
+	snipers &= theirs;
+	while (snipers)
+	{
+		sqSet blockers = pmGetBetweenSet(kingIndex, sqSetPopLsb(&snipers)) & occupied;
+		if (!(blockers & (blockers - 1)))
+			pinned |= blockers & ours;
+	}
+
+	return pinned;
+}
+
+// HELPER FUNCTION:
+// Generates the legal moves in the given stages for a player with exactly one king on the given square. Rather than
+// playing out every move to see if it leaves the king in check, the checkers and pinned pieces are worked out once up
+// front
+void boardGenerateLegalMoves(board *b, moveBuffer *buf, uint8_t kingIndex, uint8_t stages)
+{
+	pieceColor us = b->currentPlayer;
+	pieceColor them = (us == pcWhite) ? pcBlack : pcWhite;
+
+	sqSet occupied = boardGetOccupied(b);
+	sqSet ours = boardGetColorSet(b, us);
+	sqSet theirs = boardGetColorSet(b, them);
+	sqSet empty = ~occupied;
+	sqSet kingBit = (sqSet) 1 << kingIndex;
+
+	sqSet checkers = boardGetAttackersTo(b, kingIndex, occupied) & theirs;
+
+	// Captures land on their pieces, quiet moves on empty squares. Pawn pushes are the exception, since promotions
+	// count as captures
+	sqSet stageTargets = ((stages & GEN_CAPTURES) ? theirs : 0) | ((stages & GEN_QUIETS) ? empty : 0);
+	sqSet promotionRank = (us == pcWhite) ? 0xff00000000000000 : 0x00000000000000ff;
+	sqSet pushTargets = ((stages & GEN_CAPTURES) ? promotionRank : 0) | ((stages & GEN_QUIETS) ? ~promotionRank : 0);
+
+	// The king can't step onto an attacked square. It is taken off the board first, so it can't hide behind itself
+	// from a slider that is checking it
+	sqSet occupiedNoKing = occupied & ~kingBit;
+	sqSet targets = pmGetKingAttackSet(kingIndex) & stageTargets;
+	while (targets)
+	{
+		uint8_t to = sqSetPopLsb(&targets);
+		if (!(boardGetAttackersTo(b, to, occupiedNoKing) & theirs))
+			moveBufferAddPacked(buf, movePackIndex(kingIndex, to, ptEmpty));
+	}
+
+	// In double check, only the king can move
+	if (checkers & (checkers - 1))
+		return;
+
+	// In single check, other pieces must capture the checker or block it
+	sqSet evasionMask = ~((sqSet) 0);
+	if (checkers)
+		evasionMask = checkers | pmGetBetweenSet(kingIndex, sqSetLsb(checkers));
+	else if (stages & GEN_QUIETS)
+		boardAddCastlingMoves(b, buf);
+
+	sqSet pinned = boardGetPinned(b, kingIndex, ours, theirs);
+
+	sqSet epSet = sqEq(b->epTarget, SQ_INVALID) ? 0 : (sqSet) 1 << sqGetIndex(b->epTarget);
+	int8_t pawnDelta = (us == pcWhite) ? 8 : -8;
+
+	sqSet pieces = ours & ~kingBit;
+	while (pieces)
+	{
+		uint8_t i = sqSetPopLsb(&pieces);
+
+		// Pinned pieces can only move along the pin
+		sqSet allowed = ~ours & evasionMask;
+		if ((pinned >> i) & 1)
+			allowed &= pmGetLineSet(kingIndex, i);
+
+		switch (pieceGetType(boardGetPieceAt(b, i)))
+		{
+			case ptPawn:
+			{
+				// Forward moves
+				uint8_t to = i + pawnDelta;
+				if (to < 64 && ((empty >> to) & 1))
+				{
+					if (((allowed & pushTargets) >> to) & 1)
+						boardAddPawnMove(buf, i, to);
+
+					// Can this piece move two squares?
+					to += pawnDelta;
+					if ((us == pcWhite ? (i < 16) : (i >= 48)) && ((empty & allowed & pushTargets) >> to) & 1)
+						boardAddPawnMove(buf, i, to);
+				}
+
+				if (!(stages & GEN_CAPTURES))
+					continue;
+
+				// Captures
+				targets = pmGetPawnAttackSet(i, us) & theirs & allowed;
+				while (targets)
+					boardAddPawnMove(buf, i, sqSetPopLsb(&targets));
+
+				// En passant removes two pieces from the same rank, which can expose the king in ways the pin detection
+				// above can't see. So, check it directly by looking at the board as it would be after the capture
+				if (pmGetPawnAttackSet(i, us) & epSet)
+				{
+					sqSet capturedBit = (pawnDelta > 0) ? (epSet >> 8) : (epSet << 8);
+					sqSet occupiedAfter = (occupied & ~((sqSet) 1 << i) & ~capturedBit) | epSet;
+					if (!(boardGetAttackersTo(b, kingIndex, occupiedAfter) & theirs & ~capturedBit))
+						moveBufferAddPacked(buf, movePackIndex(i, sqGetIndex(b->epTarget), ptEmpty));
+				}
+
+				continue;
+			}
+
+			case ptKnight:
+				targets = pmGetKnightAttackSet(i);
+				break;
+
+			case ptBishop:
+				targets = pmGetBishopAttackSet(i, occupied);
+				break;
+
+			case ptRook:
+				targets = pmGetRookAttackSet(i, occupied);
+				break;
+
+			case ptQueen:
+				targets = pmGetQueenAttackSet(i, occupied);
+				break;
+
+			default:
+				targets = 0;
+				break;
 		}
 
-		fen++;
+		targets &= allowed & stageTargets;
+		while (targets)
+			moveBufferAddPacked(buf, movePackIndex(i, sqSetPopLsb(&targets), ptEmpty));
 	}
+}
 
-	fen++; 	// Go past the last space
+// HELPER FUNCTION:
+// Returns the stage the given pseudo legal move belongs to
+uint8_t boardGetMoveStage(board *b, packedMove pm)
+{
+	uint8_t to = packedMoveGetTo(pm);
 
-	// Read in the en passant target square
+	if (packedMoveGetPromotion(pm) != ptEmpty || boardGetPieceAt(b, to) != pEmpty)
+		return GEN_CAPTURES;
 
-	c = *fen;
-	if (c == '-')
-	{
-		b->epTarget = SQ_INVALID;
-		fen++;
-	}
-	else
+	if (pieceGetType(boardGetPieceAt(b, packedMoveGetFrom(pm))) == ptPawn && sqEq(sqIndex(to), b->epTarget))
+		return GEN_CAPTURES;
+
+	return GEN_QUIETS;
+}
+
+// HELPER FUNCTION:
+// Fills the buffer with the legal moves in the given stages
+void boardGenerateStages(board *b, moveBuffer *buf, uint8_t stages)
+{
+	moveBufferClear(buf);
+
+	uint8_t kingIndex = boardGetKingIndex(b, b->currentPlayer);
+	if (kingIndex < 64)
 	{
-		char epTargetStr[3] = {fen[0], fen[1], 0};
-		sq epTarget = sqS(epTargetStr);
-		if (epTarget.file == -1) 	// It's invalid
-		{
-			fprintf(stderr, "ERROR IN FEN: Invalid EP target square \"%s\"\n", epTargetStr);
-			return 1;
-		}
-		b->epTarget = epTarget;
-		fen += 2;
+		boardGenerateLegalMoves(b, buf, kingIndex, stages);
+		return;
 	}
 
-	c = *fen;
-	if (c != ' ')
+	// Without exactly one king (only possible with a custom FEN), pins don't make sense. Instead, play out every move
+	// and see if it leaves any of our kings in check
+	moveBuffer pseudoLegal;
+	boardGeneratePseudoLegalMoves(b, &pseudoLegal);
+
+	board bCheck;
+	for (size_t i = 0; i < pseudoLegal.size; i++)
 	{
-		fprintf(stderr, "ERROR IN FEN: Expected ' ' after EP target square, found '%c'\n", c);
-		return 1;
-	}
-	fen++;
+		if (!(boardGetMoveStage(b, pseudoLegal.moves[i]) & stages))
+			continue;
 
-	// Read in half move clock and full move count
-	// Note: more error checking should probably be done here
+		move m = moveBufferGet(&pseudoLegal, i);
+		memcpy(&bCheck, b, sizeof(board));
+		boardPlayMoveInPlace(&bCheck, m);
+		if (!boardIsPlayerInCheck(&bCheck, b->currentPlayer))
+			moveBufferAddPacked(buf, pseudoLegal.moves[i]);
+	}
+}
 
-	sscanf(fen, "%u %u", &b->halfMoveClock, &b->moveNumber);
+void boardGenerateMovesInto(board *b, moveBuffer *buf)
+{
+	boardGenerateStages(b, buf, GEN_ALL);
+}
 
-	return 0;
+void boardGenerateCaptures(board *b, moveBuffer *buf)
+{
+	boardGenerateStages(b, buf, GEN_CAPTURES);
 }
 
-void boardSetPiece(board *b, sq s, piece p)
+void boardGenerateQuiets(board *b, moveBuffer *buf)
 {
-	int index = sqGetIndex(s);
-	b->pieces[index] = p;
+	boardGenerateStages(b, buf, GEN_QUIETS);
 }
 
-piece boardGetPiece(board *b, sq s)
+void boardGenerateEvasions(board *b, moveBuffer *buf)
 {
-	int index = sqGetIndex(s);
-	return b->pieces[index];
+	if (boardIsInCheck(b))
+		boardGenerateStages(b, buf, GEN_ALL);
+	else
+		moveBufferClear(buf);
 }
 
-// Generates a list of all legal moves. This list must be freed with freeMoveList
-moveList *boardGenerateMoves(board *b)
+// HELPER FUNCTION:
+// Counts the legal moves for a player with exactly one king on the given square, the same way
+// boardGenerateLegalMoves finds them, but adding up the sizes of the target sets instead of listing every move. If
+// stopAtFirst is set, returns as soon as any legal move turns up
+size_t boardCountLegalMovesWithKing(board *b, uint8_t kingIndex, uint8_t stopAtFirst)
 {
-	moveList *list = moveListCreate();
+	pieceColor us = b->currentPlayer;
+	pieceColor them = (us == pcWhite) ? pcBlack : pcWhite;
 
-	for (int i = 0; i < 64; i++)
+	sqSet occupied = boardGetOccupied(b);
+	sqSet ours = boardGetColorSet(b, us);
+	sqSet theirs = boardGetColorSet(b, them);
+	sqSet empty = ~occupied;
+	sqSet kingBit = (sqSet) 1 << kingIndex;
+
+	sqSet checkers = boardGetAttackersTo(b, kingIndex, occupied) & theirs;
+
+	size_t count = 0;
+
+	// King moves come first, they are the only ones possible in double check
+	sqSet occupiedNoKing = occupied & ~kingBit;
+	sqSet targets = pmGetKingAttackSet(kingIndex) & ~ours;
+	while (targets)
 	{
-		sq s = sqIndex(i);
-		piece p = boardGetPiece(b, s);
+		uint8_t to = sqSetPopLsb(&targets);
+		if (!(boardGetAttackersTo(b, to, occupiedNoKing) & theirs))
+		{
+			count++;
+			if (stopAtFirst)
+				return count;
+		}
+	}
 
-		if (pieceGetColor(p) != b->currentPlayer)
-			continue;
+	if (checkers & (checkers - 1))
+		return count;
+
+	sqSet evasionMask = ~((sqSet) 0);
+	if (checkers)
+	{
+		evasionMask = checkers | pmGetBetweenSet(kingIndex, sqSetLsb(checkers));
+	}
+	else if (b->castleState & ((us == pcWhite) ? (CASTLE_WK | CASTLE_WQ) : (CASTLE_BK | CASTLE_BQ)))
+	{
+		moveBuffer castles;
+		moveBufferClear(&castles);
+		boardAddCastlingMoves(b, &castles);
+		count += castles.size;
+		if (stopAtFirst && count)
+			return count;
+	}
+
+	sqSet pinned = boardGetPinned(b, kingIndex, ours, theirs);
+
+	sqSet epSet = sqEq(b->epTarget, SQ_INVALID) ? 0 : (sqSet) 1 << sqGetIndex(b->epTarget);
+	int8_t pawnDelta = (us == pcWhite) ? 8 : -8;
+	sqSet promotionRank = (us == pcWhite) ? 0xff00000000000000 : 0x00000000000000ff;
+
+	sqSet pieces = ours & ~kingBit;
+	while (pieces)
+	{
+		uint8_t i = sqSetPopLsb(&pieces);
 
-		pieceType type = pieceGetType(p);
-		moveList *currMoves = NULL;
+		sqSet allowed = ~ours & evasionMask;
+		if ((pinned >> i) & 1)
+			allowed &= pmGetLineSet(kingIndex, i);
 
-		switch (type)
+		switch (pieceGetType(boardGetPieceAt(b, i)))
 		{
 			case ptPawn:
-				currMoves = pmGetPawnMoves(b, s);
+			{
+				targets = pmGetPawnAttackSet(i, us) & theirs;
+
+				uint8_t to = i + pawnDelta;
+				if (to < 64 && ((empty >> to) & 1))
+				{
+					targets |= (sqSet) 1 << to;
+
+					to += pawnDelta;
+					if ((us == pcWhite ? (i < 16) : (i >= 48)) && ((empty >> to) & 1))
+						targets |= (sqSet) 1 << to;
+				}
+
+				// Each move onto the last rank is four promotions
+				targets &= allowed;
+				count += sqSetCount(targets) + 3 * sqSetCount(targets & promotionRank);
+
+				if (pmGetPawnAttackSet(i, us) & epSet)
+				{
+					sqSet capturedBit = (pawnDelta > 0) ? (epSet >> 8) : (epSet << 8);
+					sqSet occupiedAfter = (occupied & ~((sqSet) 1 << i) & ~capturedBit) | epSet;
+					if (!(boardGetAttackersTo(b, kingIndex, occupiedAfter) & theirs & ~capturedBit))
+						count++;
+				}
 				break;
+			}
 
 			case ptKnight:
-				currMoves = pmGetKnightMoves(b, s);
+				count += sqSetCount(pmGetKnightAttackSet(i) & allowed);
 				break;
 
 			case ptBishop:
-				currMoves = pmGetBishopMoves(b, s);
+				count += sqSetCount(pmGetBishopAttackSet(i, occupied) & allowed);
 				break;
 
 			case ptRook:
-				currMoves = pmGetRookMoves(b, s);
+				count += sqSetCount(pmGetRookAttackSet(i, occupied) & allowed);
 				break;
 
 			case ptQueen:
-				currMoves = pmGetQueenMoves(b, s);
-				break;
-
-			case ptKing:
-				currMoves = pmGetKingMoves(b, s);
+				count += sqSetCount(pmGetQueenAttackSet(i, occupied) & allowed);
 				break;
 
 			default:
-				// Nothing to do
 				break;
 		}
 
-		if (currMoves)
-		{
-			board bCheck;
-			for (moveListNode *n = currMoves->head; n; n = n->next)
-			{
-				memcpy(&bCheck, b, sizeof(board)); 	// Done this way so less malloc+freeing required
-				move m = n->move;
-				boardPlayMoveInPlace(&bCheck, m);
-				if (!boardIsPlayerInCheck(&bCheck, b->currentPlayer))
-					moveListAdd(list, m);
-			}
-			moveListFree(currMoves);
-		}
+		if (stopAtFirst && count)
+			return count;
 	}
 
-	// Can we castle?
-	uint8_t castleOO = b->currentPlayer == pcWhite ? (b->castleState & CASTLE_WK) : (b->castleState & CASTLE_BK);
-	uint8_t castleOOO = b->currentPlayer == pcWhite ? (b->castleState & CASTLE_WQ) : (b->castleState & CASTLE_BQ);
-
-	if (castleOO || castleOOO)
-	{
-		uint8_t castleRank = b->currentPlayer == pcWhite ? 1 : 8;
-		pieceColor attacker = b->currentPlayer == pcWhite ? pcBlack : pcWhite;
+	return count;
+}
 
-		piece ourKing = b->currentPlayer == pcWhite ? pWKing : pBKing;
-		piece ourRook = b->currentPlayer == pcWhite ? pWRook : pBRook;
+uint8_t boardHasLegalMove(board *b)
+{
+	uint8_t kingIndex = boardGetKingIndex(b, b->currentPlayer);
+	if (kingIndex < 64)
+		return boardCountLegalMovesWithKing(b, kingIndex, 1) > 0;
 
-		if (castleOO)
-		{
-			if (boardGetPiece(b, sqI(5, castleRank)) == ourKing
-					&& boardGetPiece(b, sqI(8, castleRank)) == ourRook
-					&& boardGetPiece(b, sqI(6, castleRank)) == pEmpty
-					&& boardGetPiece(b, sqI(7, castleRank)) == pEmpty
-					&& !boardIsSquareAttacked(b, sqI(5, castleRank), attacker)
-					&& !boardIsSquareAttacked(b, sqI(6, castleRank), attacker)
-					&& !boardIsSquareAttacked(b, sqI(7, castleRank), attacker))
-				moveListAdd(list, moveSq(sqI(5, castleRank), sqI(7, castleRank)));
-		}
+	moveBuffer buf;
+	boardGenerateMovesInto(b, &buf);
+	return buf.size > 0;
+}
 
-		if (castleOOO)
-		{
-			if (boardGetPiece(b, sqI(5, castleRank)) == ourKing
-					&& boardGetPiece(b, sqI(1, castleRank)) == ourRook
-					&& boardGetPiece(b, sqI(4, castleRank)) == pEmpty
-					&& boardGetPiece(b, sqI(3, castleRank)) == pEmpty
-					&& boardGetPiece(b, sqI(2, castleRank)) == pEmpty
-					&& !boardIsSquareAttacked(b, sqI(5, castleRank), attacker)
-					&& !boardIsSquareAttacked(b, sqI(4, castleRank), attacker)
-					&& !boardIsSquareAttacked(b, sqI(3, castleRank), attacker))
-				moveListAdd(list, moveSq(sqI(5, castleRank), sqI(3, castleRank)));
-		}
-	}
+size_t boardCountLegalMoves(board *b)
+{
+	uint8_t kingIndex = boardGetKingIndex(b, b->currentPlayer);
+	if (kingIndex < 64)
+		return boardCountLegalMovesWithKing(b, kingIndex, 0);
 
-	return list;
+	moveBuffer buf;
+	boardGenerateMovesInto(b, &buf);
+	return buf.size;
 }
 
-uint8_t boardIsSquareAttacked(board *b, sq s, pieceColor attacker)
+// Checks the move the same way the generator would find it, rather than generating everything and searching
+uint8_t boardIsMoveLegal(board *b, move m)
 {
-	for (int i = 0; i < 64; i++)
-	{
-		sq attackerSq = sqIndex(i);
-		piece p = boardGetPiece(b, attackerSq);
+	packedMove pm = movePack(m);
+	if (pm == PACKED_MOVE_NONE)
+		return 0;
 
-		if (pieceGetColor(p) != attacker)
-			continue;
+	uint8_t from = packedMoveGetFrom(pm);
+	uint8_t to = packedMoveGetTo(pm);
+	pieceType promotion = packedMoveGetPromotion(pm);
+
+	pieceColor us = b->currentPlayer;
+	pieceColor them = (us == pcWhite) ? pcBlack : pcWhite;
 
-		pieceType type = pieceGetType(p);
-		moveList *currMoves = NULL;
+	sqSet occupied = boardGetOccupied(b);
+	sqSet ours = boardGetColorSet(b, us);
+	sqSet theirs = boardGetColorSet(b, them);
+	sqSet fromBit = (sqSet) 1 << from;
+	sqSet toBit = (sqSet) 1 << to;
 
-		uint8_t found = 0;
+	// It has to be our piece, and it can't land on another one of ours
+	if (!(ours & fromBit) || (ours & toBit))
+		return 0;
+
+	pieceType pt = pieceGetType(boardGetPieceAt(b, from));
+
+	// Only pawns reaching the last rank promote, and they must
+	uint8_t promotes = (pt == ptPawn) && (to < 8 || to >= 56);
+	if (promotes ? (promotion < ptKnight || promotion > ptQueen) : (promotion != ptEmpty))
+		return 0;
 
-		switch (type)
+	uint8_t kingIndex = boardGetKingIndex(b, us);
+	uint8_t oneKing = kingIndex < 64;
+
+	// Castling has enough special cases that it's easiest to ask the generator
+	if (pt == ptKing && from == sqGetIndex(sqI(5, us == pcWhite ? 1 : 8)) && (to == from + 2 || to == from - 2))
+	{
+		moveBuffer castles;
+		moveBufferClear(&castles);
+		boardAddCastlingMoves(b, &castles);
+		if (!moveBufferContains(&castles, m))
+			return 0;
+		if (oneKing)
+			return 1;
+	}
+	else
+	{
+		// Can the piece get there?
+		sqSet epSet = sqEq(b->epTarget, SQ_INVALID) ? 0 : (sqSet) 1 << sqGetIndex(b->epTarget);
+		sqSet reachable;
+		switch (pt)
 		{
 			case ptPawn:
-				currMoves = pmGetPawnAttacks(b, attackerSq);
+			{
+				int8_t pawnDelta = (us == pcWhite) ? 8 : -8;
+				reachable = pmGetPawnAttackSet(from, us) & (theirs | epSet);
+				if (to == from + pawnDelta && !(occupied & toBit))
+					reachable |= toBit;
+				else if (to == from + 2 * pawnDelta && (us == pcWhite ? (from < 16) : (from >= 48))
+						&& !(occupied & (toBit | ((sqSet) 1 << (from + pawnDelta)))))
+					reachable |= toBit;
 				break;
+			}
 
 			case ptKnight:
-				currMoves = pmGetKnightMoves(b, attackerSq);
+				reachable = pmGetKnightAttackSet(from);
 				break;
 
 			case ptBishop:
-				currMoves = pmGetBishopMoves(b, attackerSq);
+				reachable = pmGetBishopAttackSet(from, occupied);
 				break;
 
 			case ptRook:
-				currMoves = pmGetRookMoves(b, attackerSq);
+				reachable = pmGetRookAttackSet(from, occupied);
 				break;
 
 			case ptQueen:
-				currMoves = pmGetQueenMoves(b, attackerSq);
+				reachable = pmGetQueenAttackSet(from, occupied);
 				break;
 
 			case ptKing:
-				currMoves = pmGetKingMoves(b, attackerSq);
+				reachable = pmGetKingAttackSet(from);
 				break;
 
 			default:
-				// Nothing to do
+				reachable = 0;
 				break;
 		}
 
-		if (currMoves)
+		if (!(reachable & toBit))
+			return 0;
+
+		if (oneKing)
 		{
-			for (moveListNode *n = currMoves->head; n; n = n->next)
-			{
-				if (sqEq(s, n->move.to))
-				{
-					found = 1;
-					break;
-				}
-			}
-			moveListFree(currMoves);
-			if (found)
-				return 1;
+			// Does it leave our king attacked? Look at the board as it would be after the move, which takes care of
+			// pins, checks and en passant all at once
+			if (pt == ptKing)
+				kingIndex = to;
+			sqSet capturedBit = toBit;
+			if (pt == ptPawn && (epSet & toBit))
+				capturedBit = (us == pcWhite) ? (toBit >> 8) : (toBit << 8);
+
+			sqSet occupiedAfter = (occupied & ~fromBit & ~capturedBit) | toBit;
+			return !(boardGetAttackersTo(b, kingIndex, occupiedAfter) & theirs & ~capturedBit);
 		}
 	}
+
+	// Without exactly one king, play it out like the generator does
+	board bCheck;
+	memcpy(&bCheck, b, sizeof(board));
+	boardPlayMoveInPlace(&bCheck, m);
+	return !boardIsPlayerInCheck(&bCheck, us);
+}
+
+// Rather than generating the attacks of every enemy piece, look outwards from the square with each piece's attack
+// pattern and see if it lands on a piece that moves that way
+uint8_t boardIsSquareAttacked(board *b, sq s, pieceColor attacker)
+{
+	uint8_t index = sqGetIndex(s);
+	sqSet theirs = boardGetColorSet(b, attacker);
+
+	// A piece can't move onto its own pieces, so squares that are merely defended don't count as attacked
+	if ((theirs >> index) & 1)
+		return 0;
+
+	pieceColor defender = (attacker == pcWhite) ? pcBlack : pcWhite;
+
+	if (pmGetPawnAttackSet(index, defender) & boardGetTypeSet(b, ptPawn) & theirs)
+		return 1;
+
+	if (pmGetKnightAttackSet(index) & boardGetTypeSet(b, ptKnight) & theirs)
+		return 1;
+
+	if (pmGetKingAttackSet(index) & boardGetTypeSet(b, ptKing) & theirs)
+		return 1;
+
+	sqSet occupied = boardGetOccupied(b);
+	sqSet queens = boardGetTypeSet(b, ptQueen);
+
+	if (pmGetBishopAttackSet(index, occupied) & (boardGetTypeSet(b, ptBishop) | queens) & theirs)
+		return 1;
+
+	if (pmGetRookAttackSet(index, occupied) & (boardGetTypeSet(b, ptRook) | queens) & theirs)
+		return 1;
+
 	return 0;
 }
 
-uint8_t boardIsInCheck(board *b)
+sqSet boardAttackersOf(board *b, sq s, pieceColor attacker)
 {
-	return boardIsPlayerInCheck(b, b->currentPlayer);
+	return boardGetAttackersTo(b, sqGetIndex(s), boardGetOccupied(b)) & boardGetColorSet(b, attacker);
 }
 
-uint8_t boardIsPlayerInCheck(board *b, pieceColor player)
+uint8_t boardCanCaptureEp(board *b)
 {
-	piece royalPiece = (player == pcWhite) ? pWKing : pBKing;
-	pieceColor otherColor = (player == pcWhite) ? pcBlack : pcWhite;
-	for (int i = 0; i < 64; i++)
+	if (sqEq(b->epTarget, SQ_INVALID))
+		return 0;
+
+	pieceColor us = b->currentPlayer;
+	pieceColor them = (us == pcWhite) ? pcBlack : pcWhite;
+	uint8_t epIndex = sqGetIndex(b->epTarget);
+	sqSet epSet = (sqSet) 1 << epIndex;
+	sqSet capturedBit = (us == pcWhite) ? (epSet >> 8) : (epSet << 8);
+	sqSet theirs = boardGetColorSet(b, them) & ~capturedBit;
+
+	// Look at the board as it would be after each possible capture, and see if any of our kings are attacked
+	sqSet capturers = pmGetPawnAttackSet(epIndex, them) & boardGetTypeSet(b, ptPawn) & boardGetColorSet(b, us);
+	while (capturers)
 	{
-		sq s = sqIndex(i);
-		if (boardGetPiece(b, s) == royalPiece)
+		uint8_t from = sqSetPopLsb(&capturers);
+		sqSet occupiedAfter = (boardGetOccupied(b) & ~((sqSet) 1 << from) & ~capturedBit) | epSet;
+
+		uint8_t legal = 1;
+		sqSet kings = boardGetTypeSet(b, ptKing) & boardGetColorSet(b, us);
+		while (kings)
 		{
-			if (boardIsSquareAttacked(b, s, otherColor))
-				return 1;
+			if (boardGetAttackersTo(b, sqSetPopLsb(&kings), occupiedAfter) & theirs)
+				legal = 0;
 		}
+
+		if (legal)
+			return 1;
 	}
+
 	return 0;
 }
 
-uint8_t boardIsInsufficientMaterial(board *b)
+uint8_t boardIsInCheck(board *b)
 {
-	uint8_t numPieces = 0;
-	uint8_t numKnights = 0;
-	uint8_t numBishopsDark = 0;
-	uint8_t numBishopsLight = 0;
-	// For handling multiple/no kings
-	uint8_t numWhiteKings = 0;
-	uint8_t numBlackKings = 0;
-
-	for (int i = 0; i < 64; i++)
-	{
-		sq s = sqIndex(i);
-		piece p = boardGetPiece(b, s);
-		pieceType pt = pieceGetType(p);
-
-		if (pt != ptEmpty)
-			numPieces++;
+	return boardIsPlayerInCheck(b, b->currentPlayer);
+}
 
-		if (p == pWKing)
-			numWhiteKings++;
+uint8_t boardIsPlayerInCheck(board *b, pieceColor player)
+{
+	sqSet theirs = boardGetColorSet(b, (player == pcWhite) ? pcBlack : pcWhite);
+	sqSet occupied = boardGetOccupied(b);
 
-		if (p == pBKing)
-			numBlackKings++;
+	// Usually there's exactly one king, but custom FENs can have any number
+	sqSet kings = boardGetTypeSet(b, ptKing) & boardGetColorSet(b, player);
+	while (kings)
+	{
+		if (boardGetAttackersTo(b, sqSetPopLsb(&kings), occupied) & theirs)
+			return 1;
+	}
+	return 0;
+}
 
-		if (pt == ptKnight)
-			numKnights++;
+uint8_t boardIsInsufficientMaterial(board *b)
+{
+	uint8_t *counts = b->materialCounts;
 
-		if (pt == ptBishop)
-		{
-			if (sqIsDark(s))
-				numBishopsDark++;
-			else
-				numBishopsLight++;
-		}
-	}
+	uint8_t numPieces = 64 - counts[pEmpty];
+	uint8_t numKnights = counts[pWKnight] + counts[pBKnight];
+	uint8_t numBishopsDark = counts[MATERIAL_W_DARK_BISHOP] + counts[MATERIAL_B_DARK_BISHOP];
+	uint8_t numBishopsLight = counts[pWBishop] + counts[pBBishop];
+	// For handling multiple/no kings
+	uint8_t numWhiteKings = counts[pWKing];
+	uint8_t numBlackKings = counts[pBKing];
 
 	// Just kings, always a draw
 	if (numPieces == numWhiteKings + numBlackKings)
@@ -520,15 +1306,21 @@ board *boardPlayMove(board *b, move m)
 // NOTE - this assumes that the move is legal!
 void boardPlayMoveInPlace(board *b, move m)
 {
-	// Update the counters
-	if (b->currentPlayer == pcBlack)
+	// Take the castling rights, EP target and player out of the hash, they are put back in at the end. The EP target
+	// is cleared for now so boardSetPiece doesn't keep it up to date
+	b->hash ^= boardGetStateHash(b);
+	sq epTarget = b->epTarget;
+	b->epTarget = SQ_INVALID;
+
+	// Update the counters. They stop at the largest value they can hold rather than wrapping back to 0
+	if (b->currentPlayer == pcBlack && b->moveNumber < UINT16_MAX)
 		b->moveNumber++;
 
 	// Was this in irreversable move?
 	pieceType pt = pieceGetType(boardGetPiece(b, m.from));
 	if (pt == ptPawn || (boardGetPiece(b, m.to) != pEmpty))
 		b->halfMoveClock = 0;
-	else
+	else if (b->halfMoveClock < UINT16_MAX)
 		b->halfMoveClock++;
 
 	// Is this a castling move?
@@ -574,7 +1366,7 @@ void boardPlayMoveInPlace(board *b, move m)
 		b->castleState &= ~CASTLE_BQ;
 
 	// Is this an en passant capture?
-	if (pt == ptPawn && sqEq(b->epTarget, m.to))
+	if (pt == ptPawn && sqEq(epTarget, m.to))
 	{
 		// Remove the captured pawn
 		uint8_t delta = (b->currentPlayer == pcWhite) ? -1 : 1;
@@ -601,11 +1393,72 @@ void boardPlayMoveInPlace(board *b, move m)
 
 	// Switch current player
 	b->currentPlayer = (b->currentPlayer == pcWhite) ? pcBlack : pcWhite;
+
+	b->hash ^= boardGetStateHash(b);
+}
+
+void boardMakeMove(board *b, move m, undoInfo *undo)
+{
+	undo->captured = boardGetPiece(b, m.to);
+	undo->castleState = b->castleState;
+	undo->epTarget = b->epTarget;
+	undo->halfMoveClock = b->halfMoveClock;
+	undo->moveNumber = b->moveNumber;
+	undo->hash = b->hash;
+
+	boardPlayMoveInPlace(b, m);
+}
+
+void boardUnmakeMove(board *b, move m, const undoInfo *undo)
+{
+	// The hash is put back from undo at the end, so boardSetPiece doesn't need to keep the EP part up to date
+	b->epTarget = SQ_INVALID;
+
+	// Switch back to the player who made the move
+	b->currentPlayer = (b->currentPlayer == pcWhite) ? pcBlack : pcWhite;
+
+	piece moved = (m.promotion == ptEmpty) ? boardGetPiece(b, m.to) : pieceMake(ptPawn, b->currentPlayer);
+	pieceType pt = pieceGetType(moved);
+
+	// Put the piece back, and whatever it captured
+	boardSetPiece(b, m.from, moved);
+	boardSetPiece(b, m.to, undo->captured);
+
+	if (pt == ptPawn && sqEq(m.to, undo->epTarget))
+	{
+		// Put back the pawn that was captured en passant
+		uint8_t delta = (b->currentPlayer == pcWhite) ? -1 : 1;
+		boardSetPiece(b, sqI(m.to.file, m.to.rank + delta), b->currentPlayer == pcWhite ? pBPawn : pWPawn);
+	}
+	else if (pt == ptKing)
+	{
+		// Put the rook back if this was castling
+		int8_t diffFile = m.to.file - m.from.file;
+		if (diffFile == 2) 	// O-O
+		{
+			boardSetPiece(b, sqI(m.to.file - 1, m.to.rank), pEmpty);
+			boardSetPiece(b, sqI(8, m.to.rank), b->currentPlayer == pcWhite ? pWRook : pBRook);
+		}
+		else if (diffFile == -2) 	// O-O-O
+		{
+			boardSetPiece(b, sqI(m.to.file + 1, m.to.rank), pEmpty);
+			boardSetPiece(b, sqI(1, m.to.rank), b->currentPlayer == pcWhite ? pWRook : pBRook);
+		}
+	}
+
+	b->castleState = undo->castleState;
+	b->epTarget = undo->epTarget;
+	b->halfMoveClock = undo->halfMoveClock;
+	b->moveNumber = undo->moveNumber;
+	b->hash = undo->hash;
 }
 
 // Board equality - returns true if boards are fully equal
 uint8_t boardEq(board *b1, board *b2)
 {
+	if (b1->hash != b2->hash)
+		return 0;
+
 	if (b1->currentPlayer != b2->currentPlayer)
 		return 0;
 
@@ -621,7 +1474,7 @@ uint8_t boardEq(board *b1, board *b2)
 	if (b1->moveNumber != b2->moveNumber)
 		return 0;
 
-	if (memcmp(b1, b2, 64 * sizeof(piece)))
+	if (memcmp(b1->packedPieces, b2->packedPieces, sizeof(b1->packedPieces)))
 		return 0;
 
 	return 1;
@@ -630,102 +1483,60 @@ uint8_t boardEq(board *b1, board *b2)
 // Contextual board equality - doesn't consider counters, and filters out EP target square
 uint8_t boardEqContext(board *b1, board *b2)
 {
+	if (b1->hash != b2->hash)
+		return 0;
+
 	if (b1->currentPlayer != b2->currentPlayer)
 		return 0;
 
 	if (b1->castleState != b2->castleState)
 		return 0;
 
-	if (memcmp(b1, b2, 64 * sizeof(piece)))
+	if (memcmp(b1->packedPieces, b2->packedPieces, sizeof(b1->packedPieces)))
 		return 0;
 
-	// Filter EP target squares
-	sq b1EpTarget = b1->epTarget;
-	if (!sqEq(b1EpTarget, SQ_INVALID))
-	{
-		// Are there actually any pawns that can attack this square? If not, make it SQ_INVALID
-		int delta = b1->currentPlayer == pcWhite ? -1 : 1;
-		piece p = b1->currentPlayer == pcWhite ? pWPawn : pBPawn;
-
-		int found = 0;
-
-		sq from = sqI(b1EpTarget.file - 1, b1EpTarget.rank + delta);
-		if (boardGetPiece(b1, from) == p)
-		{
-			board b;
-			memcpy(&b, b1, sizeof(board));
-			boardPlayMoveInPlace(&b, moveSq(from, b1EpTarget));
-			if (!boardIsPlayerInCheck(&b, b1->currentPlayer))
-				found = 1;
-		}
+	// Filter EP target squares - they only count if a pawn can actually capture there
+	sq b1EpTarget = boardCanCaptureEp(b1) ? b1->epTarget : SQ_INVALID;
+	sq b2EpTarget = boardCanCaptureEp(b2) ? b2->epTarget : SQ_INVALID;
 
-		from = sqI(b1EpTarget.file + 1, b1EpTarget.rank + delta);
-		if ((!found) && (boardGetPiece(b1, from) == p))
-		{
-			board b;
-			memcpy(&b, b1, sizeof(board));
-			boardPlayMoveInPlace(&b, moveSq(from, b1EpTarget));
-			if (!boardIsPlayerInCheck(&b, b1->currentPlayer))
-				found = 1;
-		}
+	if (!sqEq(b1EpTarget, b2EpTarget))
+		return 0;
 
-		if (!found)
-			b1EpTarget = SQ_INVALID;
-	}
+	return 1;
+}
 
-	sq b2EpTarget = b2->epTarget;
-	if (!sqEq(b2EpTarget, SQ_INVALID))
+// HELPER FUNCTION:
+// Writes the given number in decimal at c, and returns a pointer just past the last digit
+char *boardWriteUnsigned(char *c, unsigned int value)
+{
+	char digits[10];
+	int n = 0;
+	do
 	{
-		// Are there actually any pawns that can attack this square? If not, make it SQ_INVALID
-		int delta = b2->currentPlayer == pcWhite ? -1 : 1;
-		piece p = b2->currentPlayer == pcWhite ? pWPawn : pBPawn;
-
-		int found = 0;
-
-		sq from = sqI(b2EpTarget.file - 1, b2EpTarget.rank + delta);
-		if (boardGetPiece(b2, from) == p)
-		{
-			board b;
-			memcpy(&b, b2, sizeof(board));
-			boardPlayMoveInPlace(&b, moveSq(from, b2EpTarget));
-			if (!boardIsPlayerInCheck(&b, b2->currentPlayer))
-				found = 1;
-		}
-
-		from = sqI(b2EpTarget.file + 1, b2EpTarget.rank + delta);
-		if ((!found) && (boardGetPiece(b2, from) == p))
-		{
-			board b;
-			memcpy(&b, b2, sizeof(board));
-			boardPlayMoveInPlace(&b, moveSq(from, b2EpTarget));
-			if (!boardIsPlayerInCheck(&b, b2->currentPlayer))
-				found = 1;
-		}
-
-		if (!found)
-			b2EpTarget = SQ_INVALID;
+		digits[n++] = '0' + (value % 10);
+		value /= 10;
 	}
+	while (value);
 
-	if (!sqEq(b1EpTarget, b2EpTarget))
-		return 0;
+	while (n)
+		*c++ = digits[--n];
 
-	return 1;
+	return c;
 }
 
-// Returns a FEN string from the given board. Must be freed
-char *boardGetFen(board *b)
+// HELPER FUNCTION:
+// Writes the FEN of the given board at c, which must have room for FEN_MAX_LENGTH characters. Returns the length
+size_t boardWriteFenUnchecked(board *b, char *buf)
 {
-	char buf[104];
 	char *c = buf;
 
 	// Pieces
-	for (uint8_t rank = 8; rank >= 1; rank--)
+	for (int rank = 7; rank >= 0; rank--)
 	{
 		uint8_t blanks = 0;
-		for (uint8_t file = 1; file <= 8; file++)
+		for (int file = 0; file < 8; file++)
 		{
-			sq s = sqI(file, rank);
-			piece p = boardGetPiece(b, s);
+			piece p = boardGetPieceAt(b, 8 * rank + file);
 			if (p)
 			{
 				if (blanks > 0)
@@ -746,7 +1557,7 @@ char *boardGetFen(board *b)
 			*c++ = '0' + blanks;
 		}
 
-		if (rank > 1)
+		if (rank > 0)
 		{
 			*c++ = '/';
 		}
@@ -795,11 +1606,39 @@ char *boardGetFen(board *b)
 
 	*c++ = ' ';
 
-	// Fill in the rest of the string with half move clock and move number
-	sprintf(c, "%u %u", b->halfMoveClock, b->moveNumber);
+	// Half move clock and move number
+	c = boardWriteUnsigned(c, b->halfMoveClock);
+	*c++ = ' ';
+	c = boardWriteUnsigned(c, b->moveNumber);
+
+	*c = 0;
+	return c - buf;
+}
+
+size_t boardWriteFen(board *b, char *buf, size_t cap)
+{
+	if (cap >= FEN_MAX_LENGTH)
+		return boardWriteFenUnchecked(b, buf);
+
+	// Not enough room to be sure it fits, so write it somewhere that does and copy over what fits
+	char full[FEN_MAX_LENGTH];
+	size_t len = boardWriteFenUnchecked(b, full);
+	if (cap > 0)
+	{
+		size_t n = (len < cap - 1) ? len : cap - 1;
+		memcpy(buf, full, n);
+		buf[n] = 0;
+	}
+	return len;
+}
+
+// Returns a FEN string from the given board. Must be freed
+char *boardGetFen(board *b)
+{
+	char buf[FEN_MAX_LENGTH];
+	size_t len = boardWriteFenUnchecked(b, buf);
 
-	size_t len = strlen(buf);
 	char *str = (char *) malloc((len + 1) * sizeof(char));
-	strcpy(str, buf);
+	memcpy(str, buf, len + 1);
 	return str;
 }
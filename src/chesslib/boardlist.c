@@ -4,100 +4,64 @@
  */
 
 #include <stdlib.h>
+#include <string.h>
 
 #include "chesslib/boardlist.h"
 
+#define BOARD_LIST_INITIAL_CAPACITY 16
+
 boardList *boardListCreate()
 {
 	boardList *list = (boardList *) malloc(sizeof(boardList));
 
-	list->head = NULL;
-	list->tail = NULL;
+	list->capacity = BOARD_LIST_INITIAL_CAPACITY;
+	list->boards = (board *) malloc(list->capacity * sizeof(board));
 	list->size = 0;
 
 	return list;
 }
 
-boardListNode *boardListNodeCreate(board *b)
+// HELPER FUNCTION:
+// Makes room for one more board
+void boardListGrow(boardList *list)
 {
-	boardListNode *node = (boardListNode *) malloc(sizeof(boardListNode));
-	node->board = b;
-	node->next = NULL;
-
-	return node;
+	if (list->size == list->capacity)
+	{
+		list->capacity *= 2;
+		list->boards = (board *) realloc(list->boards, list->capacity * sizeof(board));
+	}
 }
 
-void boardListAdd(boardList *list, board *b)
+void boardListAddCopy(boardList *list, const board *b)
 {
-	boardListNode *node = boardListNodeCreate(b);
+	boardListGrow(list);
+	memcpy(&list->boards[list->size++], b, sizeof(board));
+}
 
-	if (list->head == NULL)
-	{
-		list->head = node;
-		list->tail = node;
-	}
-	else
-	{
-		boardListNode *prevTail = list->tail;
-		prevTail->next = node;
-		list->tail = node;
-	}
+board *boardListAddNext(boardList *list)
+{
+	boardListGrow(list);
+	board *next = &list->boards[list->size];
+	memcpy(next, next - 1, sizeof(board));
 	list->size++;
+	return next;
 }
 
 board *boardListGet(boardList *list, unsigned int index)
 {
-	boardListNode *currNode = list->head;
-	while (index)
-	{
-		currNode = currNode->next;
-		index--;
-	}
-	return currNode->board;
+	return &list->boards[index];
 }
 
 void boardListUndo(boardList *list)
 {
-	// This would be easier if I made this a doubly linked...
-	if (list == NULL || list->head == NULL)
+	if (list == NULL || list->size == 0)
 		return;
 
-	if (list->head->next == NULL)
-	{
-		free(list->head->board);
-		free(list->head);
-		list->head = NULL;
-		list->tail = NULL;
-	}
-	else
-	{
-		boardListNode *prev = list->head;
-		boardListNode *curr = prev->next;
-
-		while (curr->next)
-		{
-			prev = curr;
-			curr = curr->next;
-		}
-
-		free(curr->board);
-		free(curr);
-		prev->next = NULL;
-		list->tail = prev;
-	}
-
 	list->size--;
 }
 
 void boardListFree(boardList *list)
 {
-	boardListNode *node = list->head;
-	while (node)
-	{
-		boardListNode *next = node->next;
-		free(node->board);
-		free(node);
-		node = next;
-	}
+	free(list->boards);
 	free(list);
 }
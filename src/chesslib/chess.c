@@ -33,18 +33,24 @@ void chessInitInPlace(chess *c)
 
 uint8_t chessInitFenInPlace(chess *c, const char *fen)
 {
-	board *b = boardCreateFromFen(fen);
-	if (b == NULL)
+	board b;
+	if (boardInitFromFenInPlace(&b, fen))
 		return 1;
 
 	c->boardHistory = boardListCreate();
-	boardListAdd(c->boardHistory, b);
+	boardListAddCopy(c->boardHistory, &b);
 
 	c->moveHistory = moveListCreate();
 
-	c->currentLegalMoves = NULL;
+	c->positionKeysCapacity = 64;
+	c->positionKeys = (uint64_t *) malloc(c->positionKeysCapacity * sizeof(uint64_t));
+	c->positionKeys[0] = boardGetHash(&b);
+
+	c->currentLegalMoves = moveListCreate();
+	c->legalMovesKnown = 0;
 	c->repetitions = 1;
 	c->terminal = tsOngoing;
+	c->terminalKnown = 0;
 
 	// Calculates repetitions and terminal state
 	chessCalculateFields(c);
@@ -57,21 +63,71 @@ void chessFree(chess *c)
 	boardListFree(c->boardHistory);
 	moveListFree(c->moveHistory);
 	moveListFree(c->currentLegalMoves);
+	free(c->positionKeys);
 	free(c);
 }
 
 board *chessGetBoard(chess *c)
 {
-	return c->boardHistory->tail->board;
+	return &c->boardHistory->boards[c->boardHistory->size - 1];
+}
+
+// HELPER FUNCTION:
+// Returns the draw that the rules force on the current position regardless of the moves available, or tsOngoing
+terminalState chessGetDrawByRule(chess *c)
+{
+	board *currentBoard = chessGetBoard(c);
+
+	if (c->repetitions >= 5)
+		return tsDrawFivefold;
+	if (currentBoard->halfMoveClock >= 150)
+		return tsDraw75MoveRule;
+	if (boardIsInsufficientMaterial(currentBoard))
+		return tsDrawInsufficient;
+
+	return tsOngoing;
+}
+
+// HELPER FUNCTION:
+// Returns 1 if the player to move has any legal move
+uint8_t chessHasLegalMove(chess *c)
+{
+	if (c->legalMovesKnown)
+		return c->currentLegalMoves->size > 0;
+
+	return boardHasLegalMove(chessGetBoard(c));
 }
 
 moveList *chessGetLegalMoves(chess *c)
 {
+	if (!c->legalMovesKnown)
+	{
+		moveBuffer buf;
+		boardGenerateMovesInto(chessGetBoard(c), &buf);
+
+		c->currentLegalMoves->size = 0;
+		for (size_t i = 0; i < buf.size; i++)
+			moveListAddPacked(c->currentLegalMoves, buf.moves[i]);
+
+		c->legalMovesKnown = 1;
+	}
+
 	return c->currentLegalMoves;
 }
 
 terminalState chessGetTerminalState(chess *c)
 {
+	if (!c->terminalKnown)
+	{
+		// Checkmate and stalemate come before the draw rules, so mate on the 75th move still counts
+		if (!chessHasLegalMove(c))
+			c->terminal = chessIsInCheck(c) ? tsCheckmate : tsDrawStalemate;
+		else
+			c->terminal = chessGetDrawByRule(c);
+
+		c->terminalKnown = 1;
+	}
+
 	return c->terminal;
 }
 
@@ -92,28 +148,26 @@ uint8_t chessGetRepetitions(chess *c)
 
 uint8_t chessPlayMove(chess *c, move m)
 {
-	if (c->terminal != tsOngoing)
+	// If the move turns out to be legal then there are legal moves, so only the draw rules need checking
+	if (c->terminalKnown ? (c->terminal != tsOngoing) : (chessGetDrawByRule(c) != tsOngoing))
 		return 1;
 
-	uint8_t found = 0;
-
-	for (moveListNode *n = c->currentLegalMoves->head; n; n = n->next)
-	{
-		if (moveEq(m, n->move))
-		{
-			found = 1;
-			break;
-		}
-	}
-
-	if (!found)
+	if (!boardIsMoveLegal(chessGetBoard(c), m))
 		return 1;
 
-	board *newBoard = boardPlayMove(chessGetBoard(c), m);
+	// The new board is made in place at the end of the history, so nothing is allocated for it
+	board *newBoard = boardListAddNext(c->boardHistory);
+	boardPlayMoveInPlace(newBoard, m);
 
-	boardListAdd(c->boardHistory, newBoard);
 	moveListAdd(c->moveHistory, m);
 
+	if (c->boardHistory->size > c->positionKeysCapacity)
+	{
+		c->positionKeysCapacity *= 2;
+		c->positionKeys = (uint64_t *) realloc(c->positionKeys, c->positionKeysCapacity * sizeof(uint64_t));
+	}
+	c->positionKeys[c->boardHistory->size - 1] = boardGetHash(newBoard);
+
 	chessCalculateFields(c);
 
 	return 0;
@@ -122,19 +176,19 @@ uint8_t chessPlayMove(chess *c, move m)
 uint8_t chessUndo(chess *c)
 {
 	// If there's only one board (so, no moves), return failure
-	if (c->boardHistory->head == c->boardHistory->tail)
+	if (c->boardHistory->size == 1)
 		return 1;
 
-	if (c->terminal == tsDrawClaimedThreefold || c->terminal == tsDrawClaimed50MoveRule)
-	{
-		c->terminal = tsOngoing;
-	}
-	else
+	if (c->terminalKnown && (c->terminal == tsDrawClaimedThreefold || c->terminal == tsDrawClaimed50MoveRule))
 	{
-		boardListUndo(c->boardHistory);
-		moveListUndo(c->moveHistory);
+		// Only the claim is undone, the position and its legal moves stay the same
+		c->terminalKnown = 0;
+		return 0;
 	}
 
+	boardListUndo(c->boardHistory);
+	moveListUndo(c->moveHistory);
+
 	chessCalculateFields(c);
 
 	return 0;
@@ -195,12 +249,12 @@ char *chessGetFen(chess *c)
 
 uint8_t chessCanClaimDraw50(chess *c)
 {
-	return (c->terminal == tsOngoing) && (chessGetBoard(c)->halfMoveClock >= 100);
+	return (chessGetBoard(c)->halfMoveClock >= 100) && (chessGetTerminalState(c) == tsOngoing);
 }
 
 uint8_t chessCanClaimDrawThreefold(chess *c)
 {
-	return (c->terminal == tsOngoing) && (c->repetitions >= 3);
+	return (c->repetitions >= 3) && (chessGetTerminalState(c) == tsOngoing);
 }
 
 void chessClaimDraw50(chess *c)
@@ -219,34 +273,21 @@ void chessCalculateFields(chess *c)
 {
 	board *currentBoard = chessGetBoard(c);
 
-	c->repetitions = 0;
-	for (boardListNode *n = c->boardHistory->head; n; n = n->next)
+	// A position can't repeat one from before the last capture or pawn move, so only look back as far as the half move
+	// clock goes. Only every other position has the same player to move. Hashes rule out almost everything, then the
+	// full comparison makes sure
+	size_t last = c->boardHistory->size - 1;
+	size_t lookBack = currentBoard->halfMoveClock < last ? currentBoard->halfMoveClock : last;
+	uint64_t key = c->positionKeys[last];
+
+	c->repetitions = 1;
+	for (size_t i = 2; i <= lookBack; i += 2)
 	{
-		if (boardEqContext(currentBoard, n->board))
+		if (c->positionKeys[last - i] == key && boardEqContext(currentBoard, boardListGet(c->boardHistory, last - i)))
 			c->repetitions++;
 	}
 
-	if (c->currentLegalMoves)
-		moveListFree(c->currentLegalMoves);
-
-	c->currentLegalMoves = boardGenerateMoves(currentBoard);
-
-	if (c->currentLegalMoves->size == 0)
-	{
-		if (boardIsInCheck(currentBoard))
-			c->terminal = tsCheckmate;
-		else
-			c->terminal = tsDrawStalemate;
-	}
-	else
-	{
-		if (c->repetitions >= 5)
-			c->terminal = tsDrawFivefold;
-		else if (currentBoard->halfMoveClock >= 150)
-			c->terminal = tsDraw75MoveRule;
-		else if (boardIsInsufficientMaterial(currentBoard))
-			c->terminal = tsDrawInsufficient;
-		else if ((c->terminal != tsDrawClaimed50MoveRule) && (c->terminal != tsDrawClaimedThreefold))
-			c->terminal = tsOngoing;
-	}
+	// Everything else waits until somebody asks for it
+	c->legalMovesKnown = 0;
+	c->terminalKnown = 0;
 }
@@ -0,0 +1,315 @@
+/*
+ * EPD implementation
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
+
+#include "chesslib/epd.h"
+#include "chesslib/perft.h"
+
+// A run of whole lines, handled by one worker
+typedef struct
+{
+	const char *start;
+	const char *end;
+	char *output; 	// The results for the chunk's lines, one per line
+	size_t outputSize;
+	size_t outputCapacity;
+	uint8_t done;
+} epdChunk;
+
+typedef struct
+{
+	const epdOptions *options;
+	epdChunk *chunks;
+	size_t numChunks;
+	size_t nextChunk; 	// The next chunk for a worker to take
+	pthread_mutex_t lock;
+	pthread_cond_t chunkDone;
+} epdPool;
+
+// HELPER FUNCTION:
+// Returns how much of the line is the position: the first four fields, then the counters if the next two fields are
+// numbers. Anything after that (EPD operations) would stop the FEN parser
+size_t epdGetFenLength(const char *line, size_t len)
+{
+	size_t i = 0;
+	size_t end = 0;
+	unsigned int fields = 0;
+
+	while (fields < 6)
+	{
+		while (i < len && (line[i] == ' ' || line[i] == '\t'))
+			i++;
+		if (i == len || line[i] == ';')
+			break;
+
+		uint8_t isNumber = 1;
+		while (i < len && line[i] != ' ' && line[i] != '\t' && line[i] != ';')
+		{
+			if (line[i] < '0' || line[i] > '9')
+				isNumber = 0;
+			i++;
+		}
+		fields++;
+
+		if (fields > 4 && !isNumber)
+			break;
+		end = i;
+	}
+
+	return end;
+}
+
+// HELPER FUNCTION:
+// Works out the result for one line into out, which has room for EPD_MAX_RESULT + 1 characters. Returns the length
+size_t epdProcessLine(const epdOptions *options, const char *line, size_t len, char *out)
+{
+	board b;
+	fenError error;
+	if (boardParseFen(&b, line, epdGetFenLength(line, len), &error))
+		return snprintf(out, EPD_MAX_RESULT + 1, "error: %s at character %zu", fenErrorGetStr(error.code),
+				error.offset);
+
+	size_t n;
+	switch (options->operation)
+	{
+		case eoLegalMoves:
+			n = snprintf(out, EPD_MAX_RESULT + 1, "%zu", boardCountLegalMoves(&b));
+			break;
+
+		case eoInCheck:
+			n = snprintf(out, EPD_MAX_RESULT + 1, "%u", boardIsInCheck(&b));
+			break;
+
+		case eoInsufficientMaterial:
+			n = snprintf(out, EPD_MAX_RESULT + 1, "%u", boardIsInsufficientMaterial(&b));
+			break;
+
+		case eoPerft:
+			n = snprintf(out, EPD_MAX_RESULT + 1, "%llu", (unsigned long long) perft(&b, options->depth));
+			break;
+
+		default:
+			n = options->callback(options->data, &b, line, len, out, EPD_MAX_RESULT + 1);
+			break;
+	}
+
+	return n > EPD_MAX_RESULT ? EPD_MAX_RESULT : n;
+}
+
+// HELPER FUNCTION:
+// Works out the results for every line of the chunk
+void epdProcessChunk(const epdOptions *options, epdChunk *chunk)
+{
+	chunk->outputSize = 0;
+	chunk->outputCapacity = 4096;
+	chunk->output = (char *) malloc(chunk->outputCapacity);
+
+	const char *line = chunk->start;
+	while (line < chunk->end)
+	{
+		const char *newline = (const char *) memchr(line, '\n', chunk->end - line);
+		const char *lineEnd = newline ? newline : chunk->end;
+		const char *next = newline ? newline + 1 : chunk->end;
+
+		// Trim the line, skipping it if there's nothing left
+		while (line < lineEnd && (*line == ' ' || *line == '\t'))
+			line++;
+		while (lineEnd > line && (lineEnd[-1] == '\r' || lineEnd[-1] == ' ' || lineEnd[-1] == '\t'))
+			lineEnd--;
+
+		if (line < lineEnd)
+		{
+			// Room for the longest result, its newline and snprintf's null terminator
+			if (chunk->outputCapacity - chunk->outputSize < EPD_MAX_RESULT + 2)
+			{
+				chunk->outputCapacity *= 2;
+				chunk->output = (char *) realloc(chunk->output, chunk->outputCapacity);
+			}
+
+			char *out = chunk->output + chunk->outputSize;
+			size_t n = epdProcessLine(options, line, lineEnd - line, out);
+			out[n] = '\n';
+			chunk->outputSize += n + 1;
+		}
+
+		line = next;
+	}
+}
+
+void *epdWorkerRun(void *arg)
+{
+	epdPool *pool = (epdPool *) arg;
+
+	while (1)
+	{
+		pthread_mutex_lock(&pool->lock);
+		size_t i = pool->nextChunk;
+		if (i < pool->numChunks)
+			pool->nextChunk++;
+		pthread_mutex_unlock(&pool->lock);
+
+		if (i >= pool->numChunks)
+			break;
+
+		epdProcessChunk(pool->options, &pool->chunks[i]);
+
+		pthread_mutex_lock(&pool->lock);
+		pool->chunks[i].done = 1;
+		pthread_cond_broadcast(&pool->chunkDone);
+		pthread_mutex_unlock(&pool->lock);
+	}
+
+	return NULL;
+}
+
+void epdProcessBuffer(const char *text, size_t len, const epdOptions *options, FILE *out)
+{
+	unsigned int numThreads = options->numThreads > 0 ? options->numThreads : 1;
+
+	// Split the text into chunks that end on line boundaries, small enough that each thread gets several
+	size_t chunkSize = len / (16 * numThreads);
+	if (chunkSize > EPD_CHUNK_SIZE)
+		chunkSize = EPD_CHUNK_SIZE;
+	if (chunkSize < 256)
+		chunkSize = 256;
+
+	size_t numChunks = 0;
+	size_t capacity = len / chunkSize + 1;
+	epdChunk *chunks = (epdChunk *) malloc(capacity * sizeof(epdChunk));
+
+	const char *end = text + len;
+	const char *start = text;
+	while (start < end)
+	{
+		const char *chunkEnd = (size_t) (end - start) > chunkSize ? start + chunkSize : end;
+		if (chunkEnd < end)
+		{
+			const char *newline = (const char *) memchr(chunkEnd, '\n', end - chunkEnd);
+			chunkEnd = newline ? newline + 1 : end;
+		}
+
+		chunks[numChunks].start = start;
+		chunks[numChunks].end = chunkEnd;
+		chunks[numChunks].done = 0;
+		numChunks++;
+		start = chunkEnd;
+	}
+
+	if (numThreads == 1)
+	{
+		for (size_t i = 0; i < numChunks; i++)
+		{
+			epdProcessChunk(options, &chunks[i]);
+			fwrite(chunks[i].output, 1, chunks[i].outputSize, out);
+			free(chunks[i].output);
+		}
+		free(chunks);
+		return;
+	}
+
+	epdPool pool;
+	pool.options = options;
+	pool.chunks = chunks;
+	pool.numChunks = numChunks;
+	pool.nextChunk = 0;
+	pthread_mutex_init(&pool.lock, NULL);
+	pthread_cond_init(&pool.chunkDone, NULL);
+
+	pthread_t *threads = (pthread_t *) malloc(numThreads * sizeof(pthread_t));
+	unsigned int started = 0;
+	for (unsigned int i = 0; i < numThreads; i++)
+	{
+		if (pthread_create(&threads[i], NULL, epdWorkerRun, &pool) != 0)
+			break;
+		started++;
+	}
+
+	// The calling thread writes the results out in order as they come in, and only helps out if no thread started
+	if (started == 0)
+		epdWorkerRun(&pool);
+
+	for (size_t i = 0; i < numChunks; i++)
+	{
+		pthread_mutex_lock(&pool.lock);
+		while (!chunks[i].done)
+			pthread_cond_wait(&pool.chunkDone, &pool.lock);
+		pthread_mutex_unlock(&pool.lock);
+
+		fwrite(chunks[i].output, 1, chunks[i].outputSize, out);
+		free(chunks[i].output);
+	}
+
+	for (unsigned int i = 0; i < started; i++)
+		pthread_join(threads[i], NULL);
+
+	pthread_cond_destroy(&pool.chunkDone);
+	pthread_mutex_destroy(&pool.lock);
+	free(threads);
+	free(chunks);
+}
+
+uint8_t epdProcessFile(const char *path, const epdOptions *options, FILE *out)
+{
+#ifdef _WIN32
+	// No mmap, so read the whole file in instead
+	FILE *f = fopen(path, "rb");
+	if (f == NULL)
+		return 1;
+
+	fseek(f, 0, SEEK_END);
+	long len = ftell(f);
+	fseek(f, 0, SEEK_SET);
+	if (len < 0)
+	{
+		fclose(f);
+		return 1;
+	}
+
+	char *text = (char *) malloc(len > 0 ? len : 1);
+	size_t read = fread(text, 1, len, f);
+	fclose(f);
+
+	epdProcessBuffer(text, read, options, out);
+	free(text);
+	return 0;
+#else
+	int fd = open(path, O_RDONLY);
+	if (fd < 0)
+		return 1;
+
+	struct stat st;
+	if (fstat(fd, &st) != 0)
+	{
+		close(fd);
+		return 1;
+	}
+
+	// mmap can't map an empty file, but there's nothing to do anyway
+	size_t len = st.st_size;
+	if (len == 0)
+	{
+		close(fd);
+		return 0;
+	}
+
+	void *text = mmap(NULL, len, PROT_READ, MAP_PRIVATE, fd, 0);
+	close(fd);
+	if (text == MAP_FAILED)
+		return 1;
+
+	epdProcessBuffer((const char *) text, len, options, out);
+	munmap(text, len);
+	return 0;
+#endif
+}
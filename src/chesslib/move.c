@@ -3,7 +3,6 @@
  * Created by thearst3rd on 8/6/2020
  */
 
-#include <stdio.h>
 #include <stdlib.h>
 #include <ctype.h>
 
@@ -33,21 +32,30 @@ uint8_t moveEq(move m1, move m2)
 // Returns the UCI string of the given move. Must be freed.
 char *moveGetUci(move m)
 {
-	char *str;
-	char p[2] = {0, 0};
+	char *str = (char *) malloc(UCI_MAX_LENGTH * sizeof(char));
+	moveWriteUci(m, str);
+	return str;
+}
+
+size_t moveWriteUci(move m, char *buf)
+{
+	const char *from = sqGetStr(m.from);
+	const char *to = sqGetStr(m.to);
+
+	buf[0] = from[0];
+	buf[1] = from[1];
+	buf[2] = to[0];
+	buf[3] = to[1];
+
 	if (m.promotion)
 	{
-		p[0] = tolower(pieceTypeGetLetter(m.promotion));
-		str = (char *) malloc(6 * sizeof(char));
-	}
-	else
-	{
-		str = (char *) malloc(5 * sizeof(char));
+		buf[4] = tolower(pieceTypeGetLetter(m.promotion));
+		buf[5] = 0;
+		return 5;
 	}
 
-	sprintf(str, "%s%s%s", sqGetStr(m.from), sqGetStr(m.to), p);
-
-	return str;
+	buf[4] = 0;
+	return 4;
 }
 
 // Returns a move from a UCI string
@@ -0,0 +1,29 @@
+/*
+ * Move buffer implementation
+ */
+
+#include "chesslib/movebuffer.h"
+
+uint8_t moveBufferContains(moveBuffer *buf, move m)
+{
+	packedMove pm = movePack(m);
+	if (pm == PACKED_MOVE_NONE)
+		return 0;
+
+	for (size_t i = 0; i < buf->size; i++)
+	{
+		if (buf->moves[i] == pm)
+			return 1;
+	}
+	return 0;
+}
+
+moveList *moveBufferToMoveList(moveBuffer *buf)
+{
+	moveList *list = moveListCreate();
+
+	for (size_t i = 0; i < buf->size; i++)
+		moveListAddPacked(list, buf->moves[i]);
+
+	return list;
+}
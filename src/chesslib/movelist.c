@@ -4,87 +4,47 @@
  */
 
 #include <stdlib.h>
-#include <string.h>
 
 #include "chesslib/movelist.h"
 
+#define MOVE_LIST_INITIAL_CAPACITY 16
+
 moveList *moveListCreate()
 {
 	moveList *list = (moveList *) malloc(sizeof(moveList));
 
-	list->head = NULL;
-	list->tail = NULL;
+	list->capacity = MOVE_LIST_INITIAL_CAPACITY;
+	list->moves = (packedMove *) malloc(list->capacity * sizeof(packedMove));
 	list->size = 0;
 
 	return list;
 }
 
-moveListNode *moveListNodeCreate(move move)
+void moveListAdd(moveList *list, move m)
 {
-	moveListNode *node = (moveListNode *) malloc(sizeof(moveListNode));
-	node->move = move;
-	node->next = NULL;
-
-	return node;
+	moveListAddPacked(list, movePack(m));
 }
 
-void moveListAdd(moveList *list, move move)
+void moveListAddPacked(moveList *list, packedMove pm)
 {
-	moveListNode *node = moveListNodeCreate(move);
-
-	if (list->head == NULL)
-	{
-		list->head = node;
-		list->tail = node;
-	}
-	else
+	if (list->size == list->capacity)
 	{
-		moveListNode *prevTail = list->tail;
-		prevTail->next = node;
-		list->tail = node;
+		list->capacity *= 2;
+		list->moves = (packedMove *) realloc(list->moves, list->capacity * sizeof(packedMove));
 	}
-	list->size++;
+	list->moves[list->size++] = pm;
 }
 
 move moveListGet(moveList *list, unsigned int index)
 {
-	moveListNode *currNode = list->head;
-	while (index)
-	{
-		currNode = currNode->next;
-		index--;
-	}
-	return currNode->move;
+	return moveUnpack(list->moves[index]);
 }
 
 void moveListUndo(moveList *list)
 {
-	// This would be easier if I made this a doubly linked...
-	if (list == NULL || list->head == NULL)
+	if (list == NULL || list->size == 0)
 		return;
 
-	if (list->head->next == NULL)
-	{
-		free(list->head);
-		list->head = NULL;
-		list->tail = NULL;
-	}
-	else
-	{
-		moveListNode *prev = list->head;
-		moveListNode *curr = prev->next;
-
-		while (curr->next)
-		{
-			prev = curr;
-			curr = curr->next;
-		}
-
-		free(curr);
-		prev->next = NULL;
-		list->tail = prev;
-	}
-
 	list->size--;
 }
 
@@ -100,35 +60,26 @@ char *moveListGetUciString(moveList *list)
 		return str;
 	}
 
-	if (list->size == 1)
-	{
-		str = moveGetUci(list->head->move);
-		return str;
-	}
-
 	// Count how many bytes this string will take
 	// 4 chars per move + 1 space per move - 1 space for the last move + 1 null terminator
 	size_t s = 5 * list->size;
 
 	// Add one byte for each promotion character
-	for (moveListNode *n = list->head; n; n = n->next)
+	for (size_t i = 0; i < list->size; i++)
 	{
-		if (n->move.promotion != ptEmpty)
+		if (packedMoveGetPromotion(list->moves[i]) != ptEmpty)
 			s++;
 	}
 
 	str = (char *) malloc(s * sizeof(char));
 	char *ptr = str;
 
-	// Load up the string
-	for (moveListNode *n = list->head; n; n = n->next)
+	// Load up the string, writing each move straight into it
+	for (size_t i = 0; i < list->size; i++)
 	{
-		char *moveStr = moveGetUci(n->move);
-		strcpy(ptr, moveStr);
-		ptr += strlen(moveStr);
+		ptr += moveWriteUci(moveListGet(list, i), ptr);
 		*ptr = ' ';
 		ptr++;
-		free(moveStr);
 	}
 
 	// Go back and replace the last space with a null terminator;
@@ -140,12 +91,6 @@ char *moveListGetUciString(moveList *list)
 
 void moveListFree(moveList *list)
 {
-	moveListNode *node = list->head;
-	while (node)
-	{
-		moveListNode *next = node->next;
-		free(node);
-		node = next;
-	}
+	free(list->moves);
 	free(list);
 }
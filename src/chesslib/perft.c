@@ -0,0 +1,231 @@
+/*
+ * Perft implementation
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+
+#include "chesslib/perft.h"
+
+uint64_t perft(board *b, unsigned int depth)
+{
+	if (depth == 0)
+		return 1;
+
+	// Bulk counting - the leaves don't need to be played out, or even listed
+	if (depth == 1)
+		return boardCountLegalMoves(b);
+
+	moveBuffer buf;
+	boardGenerateMovesInto(b, &buf);
+
+	uint64_t nodes = 0;
+	undoInfo undo;
+	for (size_t i = 0; i < buf.size; i++)
+	{
+		move m = moveBufferGet(&buf, i);
+		boardMakeMove(b, m, &undo);
+		nodes += perft(b, depth - 1);
+		boardUnmakeMove(b, m, &undo);
+	}
+
+	return nodes;
+}
+
+uint64_t perftDivide(board *b, unsigned int depth, moveBuffer *moves, uint64_t counts[MOVE_BUFFER_CAPACITY])
+{
+	if (depth == 0)
+	{
+		moveBufferClear(moves);
+		return 1;
+	}
+
+	boardGenerateMovesInto(b, moves);
+
+	uint64_t nodes = 0;
+	board child;
+	for (size_t i = 0; i < moves->size; i++)
+	{
+		if (depth == 1)
+		{
+			counts[i] = 1;
+		}
+		else
+		{
+			memcpy(&child, b, sizeof(board));
+			boardPlayMoveInPlace(&child, moveBufferGet(moves, i));
+			counts[i] = perft(&child, depth - 1);
+		}
+		nodes += counts[i];
+	}
+
+	return nodes;
+}
+
+
+//////////////
+// PARALLEL //
+//////////////
+
+typedef struct
+{
+	board board;
+	uint64_t nodes;
+} perftTask;
+
+// Each worker owns a range of the task array, [front, back). It takes tasks from the front, and other workers steal
+// from the back once they run out
+typedef struct
+{
+	pthread_mutex_t lock;
+	size_t front;
+	size_t back;
+} perftDeque;
+
+typedef struct
+{
+	perftTask *tasks;
+	perftDeque *deques;
+	unsigned int numThreads;
+	unsigned int depth; 	// Depth remaining below each task
+} perftPool;
+
+typedef struct
+{
+	perftPool *pool;
+	unsigned int id;
+} perftWorker;
+
+// HELPER FUNCTION:
+// Collects every position splitDepth plies below the given board into the task array
+void perftCollectTasks(board *b, unsigned int splitDepth, perftTask **tasks, size_t *size, size_t *capacity)
+{
+	if (splitDepth == 0)
+	{
+		if (*size == *capacity)
+		{
+			*capacity *= 2;
+			*tasks = (perftTask *) realloc(*tasks, *capacity * sizeof(perftTask));
+		}
+
+		memcpy(&(*tasks)[*size].board, b, sizeof(board));
+		(*tasks)[*size].nodes = 0;
+		(*size)++;
+		return;
+	}
+
+	moveBuffer buf;
+	boardGenerateMovesInto(b, &buf);
+
+	board child;
+	for (size_t i = 0; i < buf.size; i++)
+	{
+		memcpy(&child, b, sizeof(board));
+		boardPlayMoveInPlace(&child, moveBufferGet(&buf, i));
+		perftCollectTasks(&child, splitDepth - 1, tasks, size, capacity);
+	}
+}
+
+// HELPER FUNCTION:
+// Takes the next task for the given worker, from its own deque if possible, otherwise from another's.
+// Returns 0 if there is no work left anywhere
+uint8_t perftTakeTask(perftPool *pool, unsigned int id, size_t *task)
+{
+	for (unsigned int i = 0; i < pool->numThreads; i++)
+	{
+		unsigned int victim = (id + i) % pool->numThreads;
+		perftDeque *d = &pool->deques[victim];
+		uint8_t found = 0;
+
+		pthread_mutex_lock(&d->lock);
+		if (d->front < d->back)
+		{
+			// Own work comes from the front, stolen work from the back so the owner and thieves rarely meet
+			*task = (victim == id) ? d->front++ : --d->back;
+			found = 1;
+		}
+		pthread_mutex_unlock(&d->lock);
+
+		if (found)
+			return 1;
+	}
+
+	return 0;
+}
+
+void *perftWorkerRun(void *arg)
+{
+	perftWorker *worker = (perftWorker *) arg;
+	perftPool *pool = worker->pool;
+
+	board b;
+	size_t task;
+	while (perftTakeTask(pool, worker->id, &task))
+	{
+		// Work on a private copy, so nothing shared is ever touched while counting
+		memcpy(&b, &pool->tasks[task].board, sizeof(board));
+		pool->tasks[task].nodes = perft(&b, pool->depth);
+	}
+
+	return NULL;
+}
+
+uint64_t perftParallel(board *b, unsigned int depth, unsigned int numThreads, unsigned int splitDepth)
+{
+	if (numThreads <= 1 || splitDepth == 0 || depth <= splitDepth)
+		return perft(b, depth);
+
+	size_t numTasks = 0;
+	size_t capacity = 256;
+	perftTask *tasks = (perftTask *) malloc(capacity * sizeof(perftTask));
+	perftCollectTasks(b, splitDepth, &tasks, &numTasks, &capacity);
+
+	perftPool pool;
+	pool.tasks = tasks;
+	pool.numThreads = numThreads;
+	pool.depth = depth - splitDepth;
+	pool.deques = (perftDeque *) malloc(numThreads * sizeof(perftDeque));
+
+	perftWorker *workers = (perftWorker *) malloc(numThreads * sizeof(perftWorker));
+	pthread_t *threads = (pthread_t *) malloc(numThreads * sizeof(pthread_t));
+
+	// Deal the tasks out evenly to begin with
+	for (unsigned int i = 0; i < numThreads; i++)
+	{
+		pthread_mutex_init(&pool.deques[i].lock, NULL);
+		pool.deques[i].front = numTasks * i / numThreads;
+		pool.deques[i].back = numTasks * (i + 1) / numThreads;
+
+		workers[i].pool = &pool;
+		workers[i].id = i;
+	}
+
+	// The calling thread works too, as worker 0
+	unsigned int started = 1;
+	for (unsigned int i = 1; i < numThreads; i++)
+	{
+		if (pthread_create(&threads[i], NULL, perftWorkerRun, &workers[i]) != 0)
+			break;
+		started++;
+	}
+
+	perftWorkerRun(&workers[0]);
+
+	for (unsigned int i = 1; i < started; i++)
+		pthread_join(threads[i], NULL);
+
+	uint64_t nodes = 0;
+	for (size_t i = 0; i < numTasks; i++)
+		nodes += tasks[i].nodes;
+
+	for (unsigned int i = 0; i < numThreads; i++)
+		pthread_mutex_destroy(&pool.deques[i].lock);
+
+	free(threads);
+	free(workers);
+	free(pool.deques);
+	free(tasks);
+
+	return nodes;
+}
@@ -0,0 +1,315 @@
+/*
+ * PGN implementation
+ */
+
+#include <string.h>
+#include <errno.h>
+
+#ifdef _WIN32
+#include <io.h>
+#define pgnRead(fd, buf, len) _read(fd, buf, (unsigned int) (len))
+#else
+#include <unistd.h>
+#define pgnRead(fd, buf, len) read(fd, buf, len)
+#endif
+
+#include "chesslib/pgn.h"
+#include "chesslib/san.h"
+
+// HELPER FUNCTION:
+// Calls the game callback and gets ready for the next game
+void pgnEndGame(pgnReader *r, const char *result)
+{
+	if (r->callbacks.onGameEnd)
+		r->callbacks.onGameEnd(r->callbacks.data, &r->b, result, r->ply, r->error);
+	r->games++;
+
+	boardInitInPlace(&r->b);
+	r->ply = 0;
+	r->error = peNone;
+	r->inGame = 0;
+	r->inMovetext = 0;
+}
+
+// HELPER FUNCTION:
+// Handles a complete tag pair
+void pgnEndTag(pgnReader *r)
+{
+	r->name[r->nameLength] = 0;
+	r->value[r->valueLength] = 0;
+
+	// Games that don't start from the usual position give it in a FEN tag
+	if (strcmp(r->name, "FEN") == 0 && boardParseFen(&r->b, r->value, r->valueLength, NULL))
+		r->error = peBadFen;
+
+	if (r->callbacks.onTag)
+		r->callbacks.onTag(r->callbacks.data, r->name, r->value);
+}
+
+// HELPER FUNCTION:
+// Handles a complete movetext token: a move, move number, NAG or result
+void pgnEndToken(pgnReader *r)
+{
+	const char *token = r->token;
+	size_t len = r->tokenLength;
+	r->token[len] = 0;
+
+	if (strcmp(token, "1-0") == 0 || strcmp(token, "0-1") == 0 || strcmp(token, "1/2-1/2") == 0
+			|| strcmp(token, "*") == 0)
+	{
+		pgnEndGame(r, token);
+		return;
+	}
+
+	r->inGame = 1;
+	r->inMovetext = 1;
+
+	// NAGs are skipped
+	if (token[0] == '$')
+		return;
+
+	// Move numbers ("12." or "12...") are skipped, even when stuck to the move after them
+	size_t i = 0;
+	while (i < len && token[i] >= '0' && token[i] <= '9')
+		i++;
+	if (i > 0 && i < len && token[i] == '.')
+	{
+		while (i < len && token[i] == '.')
+			i++;
+		token += i;
+		len -= i;
+		if (len == 0)
+			return;
+	}
+
+	if (r->error != peNone)
+		return;
+
+	move m = moveFromSan(&r->b, token);
+	if (len >= PGN_MAX_TOKEN - 1 || sqEq(m.from, SQ_INVALID))
+	{
+		r->error = peBadMove;
+		return;
+	}
+
+	boardPlayMoveInPlace(&r->b, m);
+	r->ply++;
+
+	if (r->callbacks.onMove)
+		r->callbacks.onMove(r->callbacks.data, &r->b, m, r->ply);
+}
+
+void pgnReaderInit(pgnReader *r, const pgnCallbacks *callbacks)
+{
+	r->callbacks = *callbacks;
+	boardInitInPlace(&r->b);
+	r->ply = 0;
+	r->error = peNone;
+	r->inGame = 0;
+	r->inMovetext = 0;
+	r->lineStart = 1;
+	r->state = psBetween;
+	r->returnState = psBetween;
+	r->variationDepth = 0;
+	r->nameLength = 0;
+	r->valueLength = 0;
+	r->tokenLength = 0;
+	r->games = 0;
+}
+
+void pgnReaderFeed(pgnReader *r, const char *text, size_t len)
+{
+	size_t i = 0;
+	while (i < len)
+	{
+		char c = text[i];
+		uint8_t isSpace = c == ' ' || c == '\n' || c == '\r' || c == '\t';
+
+		switch (r->state)
+		{
+			case psToken:
+				if (isSpace || c == '{' || c == '}' || c == '(' || c == ')' || c == '[' || c == ']' || c == ';')
+				{
+					// Finish the token, then look at this character again between tokens
+					pgnEndToken(r);
+					r->state = psBetween;
+					continue;
+				}
+				if (r->tokenLength < PGN_MAX_TOKEN - 1)
+					r->token[r->tokenLength++] = c;
+				break;
+
+			case psBetween:
+				if (c == '%' && r->lineStart)
+				{
+					r->returnState = psBetween;
+					r->state = psRestOfLine;
+				}
+				else if (c == '[')
+				{
+					// A game that runs straight into the next one's tags didn't have a result
+					if (r->inMovetext)
+						pgnEndGame(r, "*");
+					r->inGame = 1;
+					r->nameLength = 0;
+					r->state = psTagName;
+				}
+				else if (c == '{')
+				{
+					r->returnState = psBetween;
+					r->state = psComment;
+				}
+				else if (c == ';')
+				{
+					r->returnState = psBetween;
+					r->state = psRestOfLine;
+				}
+				else if (c == '(')
+				{
+					r->variationDepth = 1;
+					r->state = psVariation;
+				}
+				else if (!isSpace && c != ')' && c != ']' && c != '}')
+				{
+					r->token[0] = c;
+					r->tokenLength = 1;
+					r->state = psToken;
+				}
+				break;
+
+			case psTagName:
+				if (c == '"')
+				{
+					r->valueLength = 0;
+					r->state = psTagValue;
+				}
+				else if (c == ']')
+				{
+					r->state = psBetween;
+				}
+				else if (isSpace)
+				{
+					if (r->nameLength > 0)
+						r->state = psTagBeforeValue;
+				}
+				else if (r->nameLength < PGN_MAX_TAG_NAME - 1)
+				{
+					r->name[r->nameLength++] = c;
+				}
+				break;
+
+			case psTagBeforeValue:
+				if (c == '"')
+				{
+					r->valueLength = 0;
+					r->state = psTagValue;
+				}
+				else if (c == ']')
+				{
+					r->state = psBetween;
+				}
+				break;
+
+			case psTagValue:
+				if (c == '"')
+				{
+					pgnEndTag(r);
+					r->state = psTagEnd;
+					break;
+				}
+				if (c == '\\')
+				{
+					r->state = psTagValueEscape;
+					break;
+				}
+				if (r->valueLength < PGN_MAX_TAG_VALUE - 1)
+					r->value[r->valueLength++] = c;
+				break;
+
+			case psTagValueEscape:
+				if (r->valueLength < PGN_MAX_TAG_VALUE - 1)
+					r->value[r->valueLength++] = c;
+				r->state = psTagValue;
+				break;
+
+			case psTagEnd:
+				if (c == ']' || c == '\n')
+					r->state = psBetween;
+				break;
+
+			case psComment:
+				if (c == '}')
+					r->state = r->returnState;
+				break;
+
+			case psRestOfLine:
+				if (c == '\n')
+					r->state = r->returnState;
+				break;
+
+			case psVariation:
+				if (c == '(')
+				{
+					r->variationDepth++;
+				}
+				else if (c == ')')
+				{
+					if (--r->variationDepth == 0)
+						r->state = psBetween;
+				}
+				else if (c == '{')
+				{
+					r->returnState = psVariation;
+					r->state = psComment;
+				}
+				else if (c == ';')
+				{
+					r->returnState = psVariation;
+					r->state = psRestOfLine;
+				}
+				break;
+		}
+
+		r->lineStart = c == '\n';
+		i++;
+	}
+}
+
+void pgnReaderFinish(pgnReader *r)
+{
+	if (r->state == psToken)
+		pgnEndToken(r);
+	if (r->inGame)
+		pgnEndGame(r, "*");
+	r->state = psBetween;
+	r->lineStart = 1;
+}
+
+uint64_t pgnReadBuffer(const char *text, size_t len, const pgnCallbacks *callbacks)
+{
+	pgnReader r;
+	pgnReaderInit(&r, callbacks);
+	pgnReaderFeed(&r, text, len);
+	pgnReaderFinish(&r);
+	return r.games;
+}
+
+uint64_t pgnReadFd(int fd, const pgnCallbacks *callbacks)
+{
+	pgnReader r;
+	pgnReaderInit(&r, callbacks);
+
+	char buf[PGN_READ_CHUNK];
+	while (1)
+	{
+		long n = pgnRead(fd, buf, sizeof(buf));
+		if (n < 0 && errno == EINTR)
+			continue;
+		if (n <= 0)
+			break;
+		pgnReaderFeed(&r, buf, (size_t) n);
+	}
+
+	pgnReaderFinish(&r);
+	return r.games;
+}
@@ -85,6 +85,42 @@ moveList *pmRiderMoveList(board *b, sq s, pieceType pt, int8_t dirs[][2], size_t
 	return list;
 }
 
+// Sliders look their moves up in the attack tables rather than walking each ray like pmRiderMoveList
+moveList *pmSliderMoveList(board *b, sq s, pieceType pt)
+{
+	moveList *list = moveListCreate();
+
+	piece p = boardGetPiece(b, s);
+	if (pieceGetType(p) != pt)
+		return list;
+
+	uint8_t index = sqGetIndex(s);
+	sqSet occupied = boardGetOccupied(b);
+	sqSet attacks;
+
+	switch (pt)
+	{
+		case ptBishop:
+			attacks = pmGetBishopAttackSet(index, occupied);
+			break;
+
+		case ptRook:
+			attacks = pmGetRookAttackSet(index, occupied);
+			break;
+
+		default:
+			attacks = pmGetQueenAttackSet(index, occupied);
+			break;
+	}
+
+	attacks &= ~boardGetColorSet(b, pieceGetColor(p));
+
+	while (attacks)
+		moveListAdd(list, moveSq(s, sqIndex(sqSetPopLsb(&attacks))));
+
+	return list;
+}
+
 
 //////////
 // PAWN //
@@ -208,7 +244,7 @@ int8_t bishopOffsets[4][2] = {{1, 1}, {1, -1}, {-1, -1}, {-1, 1}};
 
 moveList *pmGetBishopMoves(board *b, sq s)
 {
-	return pmRiderMoveList(b, s, ptBishop, bishopOffsets, 4);
+	return pmSliderMoveList(b, s, ptBishop);
 }
 
 
@@ -220,7 +256,7 @@ int8_t rookOffsets[4][2] = {{0, 1}, {1, 0}, {0, -1}, {-1, 0}};
 
 moveList *pmGetRookMoves(board *b, sq s)
 {
-	return pmRiderMoveList(b, s, ptRook, rookOffsets, 4);
+	return pmSliderMoveList(b, s, ptRook);
 }
 
 
@@ -232,7 +268,7 @@ int8_t royalOffsets[8][2] = {{0, 1}, {1, 1}, {1, 0}, {1, -1}, {0, -1}, {-1, -1},
 
 moveList *pmGetQueenMoves(board *b, sq s)
 {
-	return pmRiderMoveList(b, s, ptQueen, royalOffsets, 8);
+	return pmSliderMoveList(b, s, ptQueen);
 }
 
 
@@ -244,3 +280,241 @@ moveList *pmGetKingMoves(board *b, sq s)
 {
 	return pmLeaperMoveList(b, s, ptKing, royalOffsets, 8);
 }
+
+
+///////////////////
+// ATTACK TABLES //
+///////////////////
+
+// Sliders use "fancy" magic bitboards. For each square, the relevant blockers (the rays, minus the edge of the board)
+// are multiplied by a magic number, which perfectly hashes every blocker configuration into that square's slice of
+// the attack table
+
+typedef struct
+{
+	sqSet mask;
+	sqSet magic;
+	sqSet *attacks;
+	uint8_t shift;
+} pmMagic;
+
+sqSet pawnAttackTable[2][64];
+sqSet knightAttackTable[64];
+sqSet kingAttackTable[64];
+
+pmMagic bishopMagics[64];
+pmMagic rookMagics[64];
+
+sqSet bishopAttackTable[5248];
+sqSet rookAttackTable[102400];
+
+sqSet betweenTable[64][64];
+sqSet lineTable[64][64];
+
+// Walks each ray from the given square until it hits a blocker or the edge of the board. Only used to fill the tables
+sqSet pmRayAttacks(uint8_t index, sqSet occupied, int8_t dirs[][2], size_t numDirs)
+{
+	sqSet attacks = 0;
+
+	for (int i = 0; i < numDirs; i++)
+	{
+		int8_t file = (index & 7) + dirs[i][0];
+		int8_t rank = (index >> 3) + dirs[i][1];
+
+		while (file >= 0 && file < 8 && rank >= 0 && rank < 8)
+		{
+			sqSet bit = (sqSet) 1 << (8 * rank + file);
+			attacks |= bit;
+
+			if (occupied & bit)
+				break;
+
+			file += dirs[i][0];
+			rank += dirs[i][1];
+		}
+	}
+
+	return attacks;
+}
+
+sqSet pmLeaperAttacks(uint8_t index, int8_t dirs[][2], size_t numDirs)
+{
+	sqSet attacks = 0;
+
+	for (int i = 0; i < numDirs; i++)
+	{
+		int8_t file = (index & 7) + dirs[i][0];
+		int8_t rank = (index >> 3) + dirs[i][1];
+
+		if (file >= 0 && file < 8 && rank >= 0 && rank < 8)
+			attacks |= (sqSet) 1 << (8 * rank + file);
+	}
+
+	return attacks;
+}
+
+// xorshift64* - magic candidates are generated deterministically so startup time is always the same
+uint64_t pmRandom(uint64_t *state)
+{
+	*state ^= *state >> 12;
+	*state ^= *state << 25;
+	*state ^= *state >> 27;
+	return *state * 2685821657736338717ULL;
+}
+
+void pmInitMagics(pmMagic *magics, sqSet *table, int8_t dirs[][2], size_t numDirs)
+{
+	// Seeds picked per rank so that the magic search finishes quickly
+	const uint64_t seeds[8] = {728, 10316, 55013, 32803, 12281, 15100, 16645, 255};
+
+	static sqSet occupancy[4096];
+	static sqSet reference[4096];
+	static int epoch[4096];
+	static int currentEpoch = 0;
+
+	sqSet *attacks = table;
+
+	for (uint8_t index = 0; index < 64; index++)
+	{
+		pmMagic *m = &magics[index];
+
+		// The edges of the board never block anything, unless the piece is standing on that edge
+		sqSet edges = (((sqSet) 0x00000000000000FF | (sqSet) 0xFF00000000000000) & ~((sqSet) 0xFF << (index & ~7)))
+				| (((sqSet) 0x0101010101010101 | (sqSet) 0x8080808080808080) & ~((sqSet) 0x0101010101010101 << (index & 7)));
+
+		m->mask = pmRayAttacks(index, 0, dirs, numDirs) & ~edges;
+		m->shift = 64 - sqSetCount(m->mask);
+		m->attacks = attacks;
+
+		// Enumerate every subset of the mask (Carry-Rippler trick), and the attacks for each of them
+		int size = 0;
+		sqSet subset = 0;
+		do
+		{
+			occupancy[size] = subset;
+			reference[size] = pmRayAttacks(index, subset, dirs, numDirs);
+			size++;
+			subset = (subset - m->mask) & m->mask;
+		}
+		while (subset);
+
+		// Try random sparse numbers until one maps every subset without a destructive collision
+		uint64_t state = seeds[index >> 3];
+		int i = 0;
+		while (i < size)
+		{
+			do
+			{
+				m->magic = pmRandom(&state) & pmRandom(&state) & pmRandom(&state);
+			}
+			while (sqSetCount((m->magic * m->mask) >> 56) < 6);
+
+			currentEpoch++;
+			for (i = 0; i < size; i++)
+			{
+				unsigned int key = (unsigned int) (((occupancy[i] & m->mask) * m->magic) >> m->shift);
+
+				if (epoch[key] < currentEpoch)
+				{
+					epoch[key] = currentEpoch;
+					attacks[key] = reference[i];
+				}
+				else if (attacks[key] != reference[i])
+				{
+					break;
+				}
+			}
+		}
+
+		attacks += size;
+	}
+}
+
+#if defined(__GNUC__)
+__attribute__((constructor))
+#endif
+void pmInit()
+{
+	static uint8_t initialized = 0;
+	if (initialized)
+		return;
+	initialized = 1;
+
+	int8_t whitePawnOffsets[2][2] = {{-1, 1}, {1, 1}};
+	int8_t blackPawnOffsets[2][2] = {{-1, -1}, {1, -1}};
+
+	for (uint8_t index = 0; index < 64; index++)
+	{
+		pawnAttackTable[0][index] = pmLeaperAttacks(index, whitePawnOffsets, 2);
+		pawnAttackTable[1][index] = pmLeaperAttacks(index, blackPawnOffsets, 2);
+		knightAttackTable[index] = pmLeaperAttacks(index, knightOffsets, 8);
+		kingAttackTable[index] = pmLeaperAttacks(index, royalOffsets, 8);
+	}
+
+	pmInitMagics(bishopMagics, bishopAttackTable, bishopOffsets, 4);
+	pmInitMagics(rookMagics, rookAttackTable, rookOffsets, 4);
+
+	for (uint8_t index1 = 0; index1 < 64; index1++)
+	{
+		sqSet bit1 = (sqSet) 1 << index1;
+		for (uint8_t index2 = 0; index2 < 64; index2++)
+		{
+			sqSet bit2 = (sqSet) 1 << index2;
+
+			if (pmGetBishopAttackSet(index1, 0) & bit2)
+			{
+				lineTable[index1][index2] = (pmGetBishopAttackSet(index1, 0) & pmGetBishopAttackSet(index2, 0))
+						| bit1 | bit2;
+				betweenTable[index1][index2] = pmGetBishopAttackSet(index1, bit2) & pmGetBishopAttackSet(index2, bit1);
+			}
+			else if (pmGetRookAttackSet(index1, 0) & bit2)
+			{
+				lineTable[index1][index2] = (pmGetRookAttackSet(index1, 0) & pmGetRookAttackSet(index2, 0))
+						| bit1 | bit2;
+				betweenTable[index1][index2] = pmGetRookAttackSet(index1, bit2) & pmGetRookAttackSet(index2, bit1);
+			}
+		}
+	}
+}
+
+sqSet pmGetPawnAttackSet(uint8_t index, pieceColor color)
+{
+	return pawnAttackTable[color == pcBlack][index];
+}
+
+sqSet pmGetKnightAttackSet(uint8_t index)
+{
+	return knightAttackTable[index];
+}
+
+sqSet pmGetBishopAttackSet(uint8_t index, sqSet occupied)
+{
+	pmMagic *m = &bishopMagics[index];
+	return m->attacks[((occupied & m->mask) * m->magic) >> m->shift];
+}
+
+sqSet pmGetRookAttackSet(uint8_t index, sqSet occupied)
+{
+	pmMagic *m = &rookMagics[index];
+	return m->attacks[((occupied & m->mask) * m->magic) >> m->shift];
+}
+
+sqSet pmGetQueenAttackSet(uint8_t index, sqSet occupied)
+{
+	return pmGetBishopAttackSet(index, occupied) | pmGetRookAttackSet(index, occupied);
+}
+
+sqSet pmGetKingAttackSet(uint8_t index)
+{
+	return kingAttackTable[index];
+}
+
+sqSet pmGetBetweenSet(uint8_t index1, uint8_t index2)
+{
+	return betweenTable[index1][index2];
+}
+
+sqSet pmGetLineSet(uint8_t index1, uint8_t index2)
+{
+	return lineTable[index1][index2];
+}
@@ -0,0 +1,221 @@
+/*
+ * SAN implementation
+ */
+
+#include <string.h>
+
+#include "chesslib/san.h"
+#include "chesslib/piecemoves.h"
+
+// HELPER FUNCTION:
+// Returns the piece type for a SAN piece letter, or ptEmpty if it isn't one
+pieceType sanGetPieceType(char c)
+{
+	switch (c)
+	{
+		case 'N': return ptKnight;
+		case 'B': return ptBishop;
+		case 'R': return ptRook;
+		case 'Q': return ptQueen;
+		case 'K': return ptKing;
+		default: return ptEmpty;
+	}
+}
+
+// HELPER FUNCTION:
+// Returns the squares holding the current player's pieces of the given type that could move to the given square, going
+// by the attack tables. Not all of them are necessarily legal. Pawns can either capture or push there
+sqSet sanGetCandidates(board *b, pieceType pt, uint8_t to, uint8_t capture)
+{
+	pieceColor us = b->currentPlayer;
+	pieceColor them = (us == pcWhite) ? pcBlack : pcWhite;
+	sqSet occupied = boardGetOccupied(b);
+	sqSet toBit = (sqSet) 1 << to;
+
+	sqSet candidates;
+	switch (pt)
+	{
+		case ptPawn:
+			// Captures come from the squares an enemy pawn on the destination would attack, pushes from behind it
+			if (capture)
+				candidates = pmGetPawnAttackSet(to, them);
+			else if (us == pcWhite)
+				candidates = toBit >> 8 | toBit >> 16;
+			else
+				candidates = toBit << 8 | toBit << 16;
+			break;
+		case ptKnight: candidates = pmGetKnightAttackSet(to); break;
+		case ptBishop: candidates = pmGetBishopAttackSet(to, occupied); break;
+		case ptRook: candidates = pmGetRookAttackSet(to, occupied); break;
+		case ptQueen: candidates = pmGetQueenAttackSet(to, occupied); break;
+		default: candidates = pmGetKingAttackSet(to); break;
+	}
+
+	return candidates & boardGetPieceSet(b, pieceMake(pt, us));
+}
+
+size_t moveToSan(board *b, move m, char *buf)
+{
+	char *c = buf;
+	uint8_t from = sqGetIndex(m.from);
+	uint8_t to = sqGetIndex(m.to);
+	pieceType pt = pieceGetType(boardGetPieceAt(b, from));
+
+	if (pt == ptKing && (to == from + 2 || to == from - 2))
+	{
+		// Castling
+		memcpy(c, to > from ? "O-O" : "O-O-O", to > from ? 3 : 5);
+		c += to > from ? 3 : 5;
+	}
+	else
+	{
+		uint8_t capture = boardGetPieceAt(b, to) != pEmpty || (pt == ptPawn && sqEq(m.to, b->epTarget));
+
+		if (pt == ptPawn)
+		{
+			if (capture)
+				*c++ = 'a' + m.from.file - 1;
+		}
+		else
+		{
+			*c++ = pieceTypeGetLetter(pt);
+
+			// Only the other pieces of the same type that can legally get there need telling apart, and there's
+			// rarely more than one to check
+			sqSet others = sanGetCandidates(b, pt, to, capture) & ~((sqSet) 1 << from);
+			sqSet rivals = 0;
+			while (others)
+			{
+				uint8_t other = sqSetPopLsb(&others);
+				if (boardIsMoveLegal(b, moveSq(sqIndex(other), m.to)))
+					rivals |= (sqSet) 1 << other;
+			}
+
+			if (rivals)
+			{
+				sqSet fileSet = (sqSet) 0x0101010101010101 << (from & 7);
+				sqSet rankSet = (sqSet) 0xFF << (from & 0x38);
+				if (!(rivals & fileSet))
+				{
+					*c++ = 'a' + m.from.file - 1;
+				}
+				else if (!(rivals & rankSet))
+				{
+					*c++ = '1' + m.from.rank - 1;
+				}
+				else
+				{
+					*c++ = 'a' + m.from.file - 1;
+					*c++ = '1' + m.from.rank - 1;
+				}
+			}
+		}
+
+		if (capture)
+			*c++ = 'x';
+
+		*c++ = 'a' + m.to.file - 1;
+		*c++ = '1' + m.to.rank - 1;
+
+		if (m.promotion != ptEmpty)
+		{
+			*c++ = '=';
+			*c++ = pieceTypeGetLetter(m.promotion);
+		}
+	}
+
+	// Check and mate
+	undoInfo undo;
+	boardMakeMove(b, m, &undo);
+	if (boardIsInCheck(b))
+		*c++ = boardHasLegalMove(b) ? '+' : '#';
+	boardUnmakeMove(b, m, &undo);
+
+	*c = 0;
+	return c - buf;
+}
+
+move moveFromSan(board *b, const char *san)
+{
+	move none = moveSq(SQ_INVALID, SQ_INVALID);
+	size_t len = strlen(san);
+
+	// Check marks and annotations don't matter
+	while (len > 0 && (san[len - 1] == '+' || san[len - 1] == '#' || san[len - 1] == '!' || san[len - 1] == '?'))
+		len--;
+
+	// Castling
+	if ((len == 3 && (strncmp(san, "O-O", 3) == 0 || strncmp(san, "0-0", 3) == 0))
+			|| (len == 5 && (strncmp(san, "O-O-O", 5) == 0 || strncmp(san, "0-0-0", 5) == 0)))
+	{
+		// The king always castles from the e file, which also works on custom boards with more than one king
+		uint8_t rank = b->currentPlayer == pcWhite ? 1 : 8;
+		move m = moveSq(sqI(5, rank), sqI(len == 3 ? 7 : 3, rank));
+		return boardIsMoveLegal(b, m) ? m : none;
+	}
+
+	// Promotion
+	pieceType promotion = ptEmpty;
+	if (len > 0 && sanGetPieceType(san[len - 1]) != ptEmpty)
+	{
+		promotion = sanGetPieceType(san[len - 1]);
+		len--;
+		if (len > 0 && san[len - 1] == '=')
+			len--;
+	}
+
+	// Destination square
+	if (len < 2 || san[len - 2] < 'a' || san[len - 2] > 'h' || san[len - 1] < '1' || san[len - 1] > '8')
+		return none;
+	uint8_t to = (san[len - 2] - 'a') + 8 * (san[len - 1] - '1');
+	len -= 2;
+
+	// Moving piece
+	size_t i = 0;
+	pieceType pt = ptPawn;
+	if (len > 0 && sanGetPieceType(san[0]) != ptEmpty)
+	{
+		pt = sanGetPieceType(san[0]);
+		i++;
+	}
+
+	// Disambiguation, which can be a file, a rank or both
+	sqSet fromMask = ~((sqSet) 0);
+	uint8_t hasFile = 0;
+	for (; i < len; i++)
+	{
+		char c = san[i];
+		if (c >= 'a' && c <= 'h')
+		{
+			fromMask &= (sqSet) 0x0101010101010101 << (c - 'a');
+			hasFile = 1;
+		}
+		else if (c >= '1' && c <= '8')
+		{
+			fromMask &= (sqSet) 0xFF << (8 * (c - '1'));
+		}
+		else if (c != 'x' && c != ':')
+		{
+			return none;
+		}
+	}
+
+	// Only the pieces that could get there are checked, rather than generating every legal move. Pawn captures always
+	// give the file they come from
+	sqSet candidates = sanGetCandidates(b, pt, to, pt == ptPawn && hasFile) & fromMask;
+
+	// Exactly one of them has to be legal
+	move found = none;
+	while (candidates)
+	{
+		move m = movePromote(sqIndex(sqSetPopLsb(&candidates)), sqIndex(to), promotion);
+		if (boardIsMoveLegal(b, m))
+		{
+			if (!sqEq(found.from, SQ_INVALID))
+				return none;
+			found = m;
+		}
+	}
+
+	return found;
+}
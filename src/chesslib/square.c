@@ -51,10 +51,13 @@ const char *SQ_STRS[64] =
 // Create a position from the given index (same as the POS_STRS below)
 sq sqIndex(uint8_t index)
 {
-	if (index < 0 || index > 63)
+	if (index > 63)
 		return SQ_INVALID;
 
-	return sqS(SQ_STRS[index]);
+	sq s;
+	s.file = (index & 7) + 1;
+	s.rank = (index >> 3) + 1;
+	return s;
 }
 
 uint8_t sqGetIndex(sq s)
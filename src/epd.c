@@ -0,0 +1,94 @@
+/*
+ * EPD runner - works something out for every position in an EPD or FEN-per-line file
+ *
+ * Usage:
+ * 	epd [options] moves file 	 	Number of legal moves
+ * 	epd [options] check file 	 	1 if the player to move is in check, 0 if not
+ * 	epd [options] insufficient file 	1 if neither player can checkmate, 0 if they can
+ * 	epd [options] perft depth file 	Perft node count to the given depth
+ *
+ * Options:
+ * 	-t threads 	Number of threads to work with (default 1)
+ * 	-o file 	Where to write the results, one line per position in the same order (default standard output)
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "chesslib/epd.h"
+
+void printUsage(const char *name)
+{
+	fprintf(stderr, "Usage: %s [-t threads] [-o output] moves|check|insufficient|perft depth file\n", name);
+}
+
+int main(int argc, char *argv[])
+{
+	epdOptions options;
+	memset(&options, 0, sizeof(options));
+	options.numThreads = 1;
+	const char *outputPath = NULL;
+
+	int arg = 1;
+	while (arg + 1 < argc && argv[arg][0] == '-')
+	{
+		if (strcmp(argv[arg], "-t") == 0)
+			options.numThreads = atoi(argv[arg + 1]);
+		else if (strcmp(argv[arg], "-o") == 0)
+			outputPath = argv[arg + 1];
+		else
+			break;
+		arg += 2;
+	}
+
+	if (arg + 1 >= argc)
+	{
+		printUsage(argv[0]);
+		return 1;
+	}
+
+	const char *operation = argv[arg++];
+	if (strcmp(operation, "moves") == 0)
+	{
+		options.operation = eoLegalMoves;
+	}
+	else if (strcmp(operation, "check") == 0)
+	{
+		options.operation = eoInCheck;
+	}
+	else if (strcmp(operation, "insufficient") == 0)
+	{
+		options.operation = eoInsufficientMaterial;
+	}
+	else if (strcmp(operation, "perft") == 0 && arg + 1 < argc)
+	{
+		options.operation = eoPerft;
+		options.depth = atoi(argv[arg++]);
+	}
+	else
+	{
+		printUsage(argv[0]);
+		return 1;
+	}
+
+	FILE *out = stdout;
+	if (outputPath)
+	{
+		out = fopen(outputPath, "w");
+		if (out == NULL)
+		{
+			fprintf(stderr, "Couldn't open \"%s\"\n", outputPath);
+			return 1;
+		}
+	}
+
+	uint8_t failed = epdProcessFile(argv[arg], &options, out);
+	if (failed)
+		fprintf(stderr, "Couldn't read \"%s\"\n", argv[arg]);
+
+	if (out != stdout)
+		fclose(out);
+
+	return failed;
+}
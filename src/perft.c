@@ -0,0 +1,244 @@
+/*
+ * Perft runner - verifies move generation against known node counts and measures its speed
+ *
+ * Usage:
+ * 	perft [options] [depth] 	 	Runs the built in reference positions to the given depth (default 4)
+ * 	perft [options] [depth] file.epd 	Runs each position in an EPD perft suite (";D1 20 ;D2 400 ..."), to the
+ * 	 	 	 	 	 	deepest listed depth that is not more than the given depth
+ * 	perft divide depth fen 	 	 	Prints the node count below each move of the given position
+ *
+ * Options:
+ * 	-t threads 	Number of threads to count with (default 1)
+ * 	-s plies 	How many plies below the root to split the work between threads (default 2)
+ *
+ * Exits with 1 if any node count doesn't match.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "chesslib/board.h"
+#include "chesslib/perft.h"
+
+#define PERFT_MAX_DEPTH 15
+#define DEFAULT_DEPTH 4
+#define DEFAULT_SPLIT_DEPTH 2
+
+typedef struct
+{
+	char name[32];
+	char fen[128];
+	uint64_t counts[PERFT_MAX_DEPTH + 1]; 	// counts[d] is the expected node count at depth d, 0 if unknown
+} perftPosition;
+
+// Reference positions and counts from the Chess Programming Wiki
+perftPosition referencePositions[] =
+{
+	{"Initial position", INITIAL_FEN,
+			{0, 20, 400, 8902, 197281, 4865609, 119060324, 3195901860ULL}},
+	{"Kiwipete", "r3k2r/p1ppqpb1/bn2pnp1/3PN3/1p2P3/2N2Q1p/PPPBBPPP/R3K2R w KQkq - 0 1",
+			{0, 48, 2039, 97862, 4085603, 193690690, 8031647685ULL}},
+	{"Position 3", "8/2p5/3p4/KP5r/1R3p1k/8/4P1P1/8 w - - 0 1",
+			{0, 14, 191, 2812, 43238, 674624, 11030083, 178633661}},
+	{"Position 4", "r3k2r/Pppp1ppp/1b3nbN/nP6/BBP1P3/q4N2/Pp1P2PP/R2Q1RK1 w kq - 0 1",
+			{0, 6, 264, 9467, 422333, 15833292, 706045033}},
+	{"Position 5", "rnbq1k1r/pp1Pbppp/2p5/8/2B5/8/PPP1NnPP/RNBQK2R w KQ - 1 8",
+			{0, 44, 1486, 62379, 2103487, 89941194}},
+	{"Position 6", "r4rk1/1pp1qppp/p1np1n2/2b1p1B1/2B1P1b1/P1NP1N2/1PP1QPPP/R4RK1 w - - 0 10",
+			{0, 46, 2079, 89890, 3894594, 164075551, 6923051137ULL}},
+};
+
+double getTime()
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+// Runs perft on one position, prints the result. Returns 1 if the count was wrong, 0 otherwise
+int runPosition(perftPosition *pos, unsigned int depth, unsigned int threads, unsigned int splitDepth,
+		uint64_t *totalNodes, double *totalTime)
+{
+	board b;
+	if (boardInitFromFenInPlace(&b, pos->fen))
+	{
+		printf("%-24s invalid FEN \"%s\"\n", pos->name, pos->fen);
+		return 1;
+	}
+
+	double start = getTime();
+	uint64_t nodes = perftParallel(&b, depth, threads, splitDepth);
+	double elapsed = getTime() - start;
+
+	*totalNodes += nodes;
+	*totalTime += elapsed;
+
+	uint64_t expected = pos->counts[depth];
+	const char *status = (expected == 0) ? "unverified" : ((nodes == expected) ? "OK" : "MISMATCH");
+
+	printf("%-24s depth %2u %14llu nodes %10.3f s %10.2f Mnps   %s",
+			pos->name, depth, (unsigned long long) nodes, elapsed,
+			elapsed > 0 ? nodes / elapsed / 1e6 : 0.0, status);
+	if (expected != 0 && nodes != expected)
+		printf(" (expected %llu)", (unsigned long long) expected);
+	printf("\n");
+
+	return expected != 0 && nodes != expected;
+}
+
+// Reads an EPD perft suite. Returns the number of positions read, or -1 if the file couldn't be opened. Must be freed
+int readEpd(const char *path, perftPosition **positions)
+{
+	FILE *f = fopen(path, "r");
+	if (f == NULL)
+		return -1;
+
+	int count = 0;
+	int capacity = 16;
+	*positions = (perftPosition *) malloc(capacity * sizeof(perftPosition));
+
+	char line[1024];
+	while (fgets(line, sizeof(line), f))
+	{
+		char *semicolon = strchr(line, ';');
+		if (semicolon == NULL)
+			continue;
+
+		if (count == capacity)
+		{
+			capacity *= 2;
+			*positions = (perftPosition *) realloc(*positions, capacity * sizeof(perftPosition));
+		}
+
+		perftPosition *pos = &(*positions)[count];
+		memset(pos, 0, sizeof(perftPosition));
+		sprintf(pos->name, "EPD line %d", count + 1);
+
+		// Everything before the first ';' is the FEN, which might be missing the counters. Lines with more there than
+		// any FEN could have are skipped
+		*semicolon = 0;
+		if (snprintf(pos->fen, sizeof(pos->fen), "%s", line) >= (int) sizeof(pos->fen))
+			continue;
+
+		char *field = semicolon + 1;
+		while (field)
+		{
+			unsigned int depth;
+			unsigned long long nodes;
+			if (sscanf(field, " D%u %llu", &depth, &nodes) == 2 && depth >= 1 && depth <= PERFT_MAX_DEPTH)
+				pos->counts[depth] = nodes;
+
+			field = strchr(field, ';');
+			if (field)
+				field++;
+		}
+
+		count++;
+	}
+
+	fclose(f);
+	return count;
+}
+
+int runDivide(unsigned int depth, const char *fen)
+{
+	board b;
+	if (boardInitFromFenInPlace(&b, fen))
+		return 1;
+
+	moveBuffer moves;
+	uint64_t counts[MOVE_BUFFER_CAPACITY];
+
+	double start = getTime();
+	uint64_t nodes = perftDivide(&b, depth, &moves, counts);
+	double elapsed = getTime() - start;
+
+	for (size_t i = 0; i < moves.size; i++)
+	{
+		char *uci = moveGetUci(moveBufferGet(&moves, i));
+		printf("%s: %llu\n", uci, (unsigned long long) counts[i]);
+		free(uci);
+	}
+
+	printf("\nMoves: %zu\nNodes: %llu\nTime: %.3f s\n", moves.size, (unsigned long long) nodes, elapsed);
+
+	return 0;
+}
+
+int main(int argc, char *argv[])
+{
+	if (argc >= 2 && strcmp(argv[1], "divide") == 0)
+	{
+		if (argc < 4)
+		{
+			fprintf(stderr, "Usage: %s divide depth fen\n", argv[0]);
+			return 1;
+		}
+		return runDivide(atoi(argv[2]), argv[3]);
+	}
+
+	unsigned int threads = 1;
+	unsigned int splitDepth = DEFAULT_SPLIT_DEPTH;
+
+	int arg = 1;
+	while (arg + 1 < argc && argv[arg][0] == '-')
+	{
+		if (strcmp(argv[arg], "-t") == 0)
+			threads = atoi(argv[arg + 1]);
+		else if (strcmp(argv[arg], "-s") == 0)
+			splitDepth = atoi(argv[arg + 1]);
+		else
+			break;
+		arg += 2;
+	}
+
+	unsigned int depth = (arg < argc) ? atoi(argv[arg]) : DEFAULT_DEPTH;
+	if (depth < 1 || depth > PERFT_MAX_DEPTH)
+	{
+		fprintf(stderr, "Depth must be between 1 and %d\n", PERFT_MAX_DEPTH);
+		return 1;
+	}
+
+	perftPosition *positions = referencePositions;
+	int numPositions = sizeof(referencePositions) / sizeof(referencePositions[0]);
+	uint8_t fromEpd = 0;
+
+	if (arg + 1 < argc)
+	{
+		numPositions = readEpd(argv[arg + 1], &positions);
+		if (numPositions < 0)
+		{
+			fprintf(stderr, "Couldn't open \"%s\"\n", argv[arg + 1]);
+			return 1;
+		}
+		fromEpd = 1;
+	}
+
+	int failures = 0;
+	uint64_t totalNodes = 0;
+	double totalTime = 0;
+
+	for (int i = 0; i < numPositions; i++)
+	{
+		unsigned int posDepth = depth;
+
+		// Suites list counts up to different depths, so go as deep as they allow
+		if (fromEpd)
+		{
+			while (posDepth > 1 && positions[i].counts[posDepth] == 0)
+				posDepth--;
+		}
+
+		failures += runPosition(&positions[i], posDepth, threads, splitDepth, &totalNodes, &totalTime);
+	}
+
+	printf("\nTotal: %llu nodes in %.3f s (%.2f Mnps), %d mismatch(es)\n", (unsigned long long) totalNodes, totalTime,
+			totalTime > 0 ? totalNodes / totalTime / 1e6 : 0.0, failures);
+
+	if (fromEpd)
+		free(positions);
+
+	return failures ? 1 : 0;
+}
@@ -6,6 +6,7 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <unistd.h>
 
 #include "tests.h"
 #include "chesslib/squareset.h"
@@ -13,6 +14,12 @@
 #include "chesslib/board.h"
 #include "chesslib/piecemoves.h"
 #include "chesslib/boardlist.h"
+#include "chesslib/perft.h"
+#include "chesslib/chess.h"
+#include "chesslib/san.h"
+#include "chesslib/pgn.h"
+#include "chesslib/epd.h"
+#include "chesslib/book.h"
 
 const char *currTest;
 
@@ -31,7 +38,9 @@ int main(int argc, char *argv[])
 	// Test Move
 	RUN_TEST(testMoveCreate);
 	RUN_TEST(testMoveGetUci);
+	RUN_TEST(testMoveWriteUci);
 	RUN_TEST(testMoveFromUci);
+	RUN_TEST(testMovePack);
 
 	// Test Move List
 	RUN_TEST(testMoveList);
@@ -39,7 +48,10 @@ int main(int argc, char *argv[])
 	// Test Board
 	RUN_TEST(testBoardCreate);
 	RUN_TEST(testBoardCreateFromFen);
+	RUN_TEST(testBoardParseFen);
 	//RUN_TEST(testBoardEq);
+	RUN_TEST(testBoardBitboards);
+	RUN_TEST(testBoardHash);
 
 	// Test Piece Moves
 	RUN_TEST(testPawnMoves);
@@ -48,23 +60,34 @@ int main(int argc, char *argv[])
 	RUN_TEST(testRookMoves);
 	RUN_TEST(testQueenMoves);
 	RUN_TEST(testKingMoves);
+	RUN_TEST(testSliderAttackSets);
 
 	// Test Attacked Squares
 	RUN_TEST(testIsSquareAttacked);
 	RUN_TEST(testIsInCheck);
+	RUN_TEST(testBoardAttackersOf);
+	RUN_TEST(testBoardGetKingSquare);
 
 	// Test playing moves
 	RUN_TEST(testBoardPlayMove);
+	RUN_TEST(testBoardMakeUnmakeMove);
 
 	// Test board move generation
 	RUN_TEST(testBoardGenerateMoves);
 	RUN_TEST(testBoardGenerateMovesCastling);
+	RUN_TEST(testBoardGenerateMovesInto);
+	RUN_TEST(testBoardGenerateMovesPinsAndChecks);
+	RUN_TEST(testBoardCountLegalMoves);
+	RUN_TEST(testBoardIsMoveLegal);
+	RUN_TEST(testBoardGenerateStages);
 
 	// Test FEN generation
 	RUN_TEST(testBoardGetFen);
+	RUN_TEST(testBoardWriteFen);
 
 	// Test draw by insufficient material
 	RUN_TEST(testBoardIsInsufficientMaterial);
+	RUN_TEST(testBoardMaterialKey);
 
 	// Test board list
 	RUN_TEST(testBoardList);
@@ -73,6 +96,26 @@ int main(int argc, char *argv[])
 	RUN_TEST(testSqSetSet);
 	RUN_TEST(testSqSetGet);
 
+	// Test perft
+	RUN_TEST(testPerft);
+
+	// Test chess game
+	RUN_TEST(testChessRepetitions);
+	RUN_TEST(testChessTerminalState);
+
+	// Test SAN
+	RUN_TEST(testMoveToSan);
+	RUN_TEST(testMoveFromSan);
+
+	// Test PGN
+	RUN_TEST(testPgnRead);
+
+	// Test EPD
+	RUN_TEST(testEpdProcess);
+
+	// Test opening books
+	RUN_TEST(testBook);
+
 	// We made it to the end
 	printf("Success - all tests passed!\n");
 	return 0;
@@ -111,6 +154,61 @@ void validateString(const char *actual, const char *expected)
 	}
 }
 
+// Positions the board tests walk through. Between them they have castling, promotions, en passant (including captures
+// that are pinned or give discovered check), checkmate, stalemate and boards with two kings of one color
+const char *referenceFens[] =
+{
+	INITIAL_FEN,
+	"r3k2r/p1ppqpb1/bn2pnp1/3PN3/1p2P3/2N2Q1p/PPPBBPPP/R3K2R w KQkq - 0 1",
+	"8/2p5/3p4/KP5r/1R3p1k/8/4P1P1/8 w - - 0 1",
+	"r3k2r/Pppp1ppp/1b3nbN/nP6/BBP1P3/q4N2/Pp1P2PP/R2Q1RK1 w kq - 0 1",
+	"rnbq1k1r/pp1Pbppp/2p5/8/2B5/8/PPP1NnPP/RNBQK2R w KQ - 1 8",
+	"rnbqkbnr/ppp1p1pp/8/3pPp2/8/8/PPPP1PPP/RNBQKBNR w KQkq f6 0 3",
+	"r3k2r/8/8/8/8/8/8/R3K2R b KQkq - 5 40",
+	"8/8/8/KPp4r/8/8/8/7k w - c6 0 1",
+	"8/8/8/2k5/3Pp3/8/8/4K3 b - d3 0 1",
+	"rnb1kbnr/pppp1ppp/8/4p3/6Pq/5P2/PPPPP2P/RNBQKBNR w KQkq - 1 3", 	// Checkmate
+	"7k/5Q2/8/8/8/8/8/K7 b - - 0 1", 	// Stalemate
+	"4k3/8/8/8/8/8/8/1K2K3 w - - 0 1", 	// Two kings, so the fallbacks are used
+	"4k3/8/8/8/8/8/8/R3K1KR w KQ - 0 1",
+};
+
+// HELPER - something to check in each position walkPositions comes to. Fails the test if it's wrong
+typedef void (*positionCheck)(board *b);
+
+// HELPER - runs the check on the board and every position up to depth moves after it, playing the moves with
+// make/unmake
+void walkPositions(board *b, unsigned int depth, positionCheck check)
+{
+	check(b);
+
+	if (depth == 0)
+		return;
+
+	moveBuffer buf;
+	boardGenerateMovesInto(b, &buf);
+
+	undoInfo undo;
+	for (size_t i = 0; i < buf.size; i++)
+	{
+		move m = moveBufferGet(&buf, i);
+		boardMakeMove(b, m, &undo);
+		walkPositions(b, depth - 1, check);
+		boardUnmakeMove(b, m, &undo);
+	}
+}
+
+// HELPER - runs walkPositions from each of referenceFens
+void walkReferencePositions(unsigned int depth, positionCheck check)
+{
+	board b;
+	for (size_t i = 0; i < sizeof(referenceFens) / sizeof(referenceFens[0]); i++)
+	{
+		boardInitFromFenInPlace(&b, referenceFens[i]);
+		walkPositions(&b, depth, check);
+	}
+}
+
 
 /////////////////
 // TEST SQUARE //
@@ -235,6 +333,42 @@ void testMoveGetUci()
 	validateString(moveGetUci(m), "c2b1q");
 }
 
+void testMoveWriteUci()
+{
+	char buf[UCI_MAX_LENGTH];
+
+	if (moveWriteUci(moveFromUci("e2e4"), buf) != 4)
+		failTest("moveWriteUci returned the wrong length");
+	validateString(buf, "e2e4");
+
+	if (moveWriteUci(moveFromUci("a7a8n"), buf) != 5)
+		failTest("moveWriteUci returned the wrong length for a promotion");
+	validateString(buf, "a7a8n");
+
+	// Move lists are written the same way
+	moveList *list = moveListCreate();
+	moveListAdd(list, moveFromUci("e2e4"));
+	char *str = moveListGetUciString(list);
+	validateString(str, "e2e4");
+	free(str);
+
+	moveListAdd(list, moveFromUci("d7d5"));
+	moveListAdd(list, moveFromUci("e4d5"));
+	moveListAdd(list, moveFromUci("c7c6"));
+	moveListAdd(list, moveFromUci("d5c6"));
+	moveListAdd(list, moveFromUci("d8d2"));
+	moveListAdd(list, moveFromUci("b1d2"));
+	moveListAdd(list, moveFromUci("e7e5"));
+	moveListAdd(list, moveFromUci("c6b7"));
+	moveListAdd(list, moveFromUci("e5e4"));
+	moveListAdd(list, moveFromUci("b7a8q"));
+	str = moveListGetUciString(list);
+	validateString(str, "e2e4 d7d5 e4d5 c7c6 d5c6 d8d2 b1d2 e7e5 c6b7 e5e4 b7a8q");
+	free(str);
+
+	moveListFree(list);
+}
+
 void testMoveFromUci()
 {
 	// maybe TODO - make this test more thorough
@@ -245,6 +379,37 @@ void testMoveFromUci()
 	validateMove(m, sqI(3, 2), sqI(2, 1), ptQueen);
 }
 
+void testMovePack()
+{
+	// Every move should survive a round trip, and only equal moves should pack the same
+	for (uint8_t from = 0; from < 64; from++)
+	{
+		for (uint8_t to = 0; to < 64; to++)
+		{
+			for (pieceType pt = ptEmpty; pt <= ptKing; pt++)
+			{
+				move m = movePromote(sqIndex(from), sqIndex(to), pt);
+				packedMove pm = movePack(m);
+				if (pm != movePackIndex(from, to, pt))
+					failTest("movePack didn't agree with movePackIndex");
+
+				validateMove(moveUnpack(pm), sqIndex(from), sqIndex(to), pt);
+				validateMove(moveUnpack(pm | PACKED_MOVE_FLAG), sqIndex(from), sqIndex(to), pt);
+			}
+		}
+	}
+
+	if (movePack(moveFromUci("e7e8q")) == movePack(moveFromUci("e7e8n")))
+		failTest("Different promotions packed the same");
+
+	// Squares off the board can't be packed
+	if (movePack(moveSq(SQ_INVALID, sqI(5, 4))) != PACKED_MOVE_NONE)
+		failTest("Move from an invalid square didn't pack to PACKED_MOVE_NONE");
+
+	if (movePack(moveSq(sqI(5, 2), sqI(9, 4))) != PACKED_MOVE_NONE)
+		failTest("Move to an off board square didn't pack to PACKED_MOVE_NONE");
+}
+
 
 ///////////////////
 // TEST MOVELIST //
@@ -273,7 +438,7 @@ void testMoveList()
 	expected = "e2e4";
 	if (strcmp(uci, expected) != 0)
 	{
-		char failStr[30];
+		char failStr[50];
 		sprintf(failStr, "Actual \"%s\" but, expected \"%s\"", uci, expected);
 		failTest(failStr);
 	}
@@ -283,7 +448,7 @@ void testMoveList()
 	expected = "e7e5";
 	if (strcmp(uci, expected) != 0)
 	{
-		char failStr[30];
+		char failStr[50];
 		sprintf(failStr, "Actual \"%s\" but, expected \"%s\"", uci, expected);
 		failTest(failStr);
 	}
@@ -293,12 +458,30 @@ void testMoveList()
 	expected = "e1e2";
 	if (strcmp(uci, expected) != 0)
 	{
-		char failStr[30];
+		char failStr[50];
 		sprintf(failStr, "Actual \"%s\" but, expected \"%s\"", uci, expected);
 		failTest(failStr);
 	}
 	free(uci);
 
+	// Undo should only drop the last move
+	moveListUndo(list);
+	if (list->size != 2 || !moveEq(moveListGet(list, 1), m2))
+		failTest("moveListUndo didn't remove just the last move");
+
+	// Growing past the initial capacity should keep every move in place
+	for (int i = 0; i < 100; i++)
+		moveListAdd(list, (i % 2) ? m1 : m3);
+	if (list->size != 102 || !moveEq(moveListGet(list, 0), m1) || !moveEq(moveListGet(list, 101), m1)
+			|| !moveEq(moveListGet(list, 100), m3))
+		failTest("moveList lost moves while growing");
+
+	while (list->size)
+		moveListUndo(list);
+	moveListUndo(list);
+	if (list->size != 0)
+		failTest("moveListUndo on an empty list changed the size");
+
 	moveListFree(list);
 }
 
@@ -319,6 +502,59 @@ void assertPiece(piece actual, piece expected)
 	}
 }
 
+// HELPER - validates that the bitboards of the given board agree with its pieces array
+void validateBoardBitboards(board *b)
+{
+	for (int i = 0; i < 64; i++)
+	{
+		sq s = sqIndex(i);
+		piece p = boardGetPiece(b, s);
+
+		for (piece other = pEmpty; other <= pBKing; other++)
+		{
+			uint8_t expected = (p == other);
+			uint8_t actual = (boardGetPieceSet(b, other) >> i) & 1;
+			if (expected != actual)
+			{
+				char message[80];
+				sprintf(message, "Square %s was %d in the set for '%c', expected %d",
+						sqGetStr(s), actual, pieceGetLetter(other), expected);
+				failTest(message);
+			}
+		}
+
+		if (((boardGetOccupied(b) >> i) & 1) != (p != pEmpty))
+		{
+			char message[50];
+			sprintf(message, "Square %s has the wrong occupancy", sqGetStr(s));
+			failTest(message);
+		}
+	}
+
+	// The material counts should agree with the bitboards too
+	for (piece p = pEmpty; p <= pBKing; p++)
+	{
+		sqSet pieceSet = boardGetPieceSet(b, p);
+		uint8_t expected = sqSetCount(pieceSet);
+		uint8_t actual = b->materialCounts[p];
+		if (p == pWBishop || p == pBBishop)
+		{
+			expected = sqSetCount(pieceSet & ~SQSET_DARK);
+			uint8_t expectedDark = sqSetCount(pieceSet & SQSET_DARK);
+			uint8_t actualDark = b->materialCounts[p == pWBishop ? MATERIAL_W_DARK_BISHOP : MATERIAL_B_DARK_BISHOP];
+			if (expectedDark != actualDark)
+				failTest("Wrong count of dark squared bishops");
+		}
+
+		if (expected != actual)
+		{
+			char message[50];
+			sprintf(message, "Counted %u of '%c', expected %u", actual, pieceGetLetter(p), expected);
+			failTest(message);
+		}
+	}
+}
+
 void testBoardCreate()
 {
 	board *b = boardCreate();
@@ -326,32 +562,32 @@ void testBoardCreate()
 	if (b == NULL)
 		failTest("Created board was NULL");
 
-	assertPiece(b->pieces[0], pWRook);
-	assertPiece(b->pieces[1], pWKnight);
-	assertPiece(b->pieces[2], pWBishop);
-	assertPiece(b->pieces[3], pWQueen);
-	assertPiece(b->pieces[4], pWKing);
-	assertPiece(b->pieces[5], pWBishop);
-	assertPiece(b->pieces[6], pWKnight);
-	assertPiece(b->pieces[7], pWRook);
+	assertPiece(boardGetPieceAt(b, 0), pWRook);
+	assertPiece(boardGetPieceAt(b, 1), pWKnight);
+	assertPiece(boardGetPieceAt(b, 2), pWBishop);
+	assertPiece(boardGetPieceAt(b, 3), pWQueen);
+	assertPiece(boardGetPieceAt(b, 4), pWKing);
+	assertPiece(boardGetPieceAt(b, 5), pWBishop);
+	assertPiece(boardGetPieceAt(b, 6), pWKnight);
+	assertPiece(boardGetPieceAt(b, 7), pWRook);
 
 	for (int i = 8; i < 16; i++)
-		assertPiece(b->pieces[i], pWPawn);
+		assertPiece(boardGetPieceAt(b, i), pWPawn);
 
 	for (int i = 16; i < 48; i++)
-		assertPiece(b->pieces[i], pEmpty);
+		assertPiece(boardGetPieceAt(b, i), pEmpty);
 
 	for (int i = 48; i < 56; i++)
-		assertPiece(b->pieces[i], pBPawn);
+		assertPiece(boardGetPieceAt(b, i), pBPawn);
 
-	assertPiece(b->pieces[56], pBRook);
-	assertPiece(b->pieces[57], pBKnight);
-	assertPiece(b->pieces[58], pBBishop);
-	assertPiece(b->pieces[59], pBQueen);
-	assertPiece(b->pieces[60], pBKing);
-	assertPiece(b->pieces[61], pBBishop);
-	assertPiece(b->pieces[62], pBKnight);
-	assertPiece(b->pieces[63], pBRook);
+	assertPiece(boardGetPieceAt(b, 56), pBRook);
+	assertPiece(boardGetPieceAt(b, 57), pBKnight);
+	assertPiece(boardGetPieceAt(b, 58), pBBishop);
+	assertPiece(boardGetPieceAt(b, 59), pBQueen);
+	assertPiece(boardGetPieceAt(b, 60), pBKing);
+	assertPiece(boardGetPieceAt(b, 61), pBBishop);
+	assertPiece(boardGetPieceAt(b, 62), pBKnight);
+	assertPiece(boardGetPieceAt(b, 63), pBRook);
 
 	if (b->currentPlayer != pcWhite)
 		failTest("Actual: black to play, expected: white to play");
@@ -392,16 +628,16 @@ void testBoardCreateFromFen()
 		if ((i == 5) || (i == 6) || (i == 7) || (i == 18) || (i == 28) || (i == 29) || (i == 43))
 			continue;
 
-		assertPiece(b->pieces[i], pEmpty);
+		assertPiece(boardGetPieceAt(b, i), pEmpty);
 	}
 
-	assertPiece(b->pieces[5], pWQueen);
-	assertPiece(b->pieces[6], pWQueen);
-	assertPiece(b->pieces[7], pWQueen);
-	assertPiece(b->pieces[28], pWPawn);
-	assertPiece(b->pieces[29], pBPawn);
-	assertPiece(b->pieces[18], pWKing);
-	assertPiece(b->pieces[43], pBKing);
+	assertPiece(boardGetPieceAt(b, 5), pWQueen);
+	assertPiece(boardGetPieceAt(b, 6), pWQueen);
+	assertPiece(boardGetPieceAt(b, 7), pWQueen);
+	assertPiece(boardGetPieceAt(b, 28), pWPawn);
+	assertPiece(boardGetPieceAt(b, 29), pBPawn);
+	assertPiece(boardGetPieceAt(b, 18), pWKing);
+	assertPiece(boardGetPieceAt(b, 43), pBKing);
 
 	if (b->currentPlayer != pcBlack)
 		failTest("Actual: white to play, expected: black to play");
@@ -433,6 +669,81 @@ void testBoardCreateFromFen()
 	free(b);
 }
 
+// HELPER - checks that parsing the given FEN fails with the given error at the given offset
+void validateFenError(const char *fen, fenErrorCode expectedCode, size_t expectedOffset)
+{
+	board b;
+	fenError error;
+	if (!boardParseFen(&b, fen, strlen(fen), &error))
+	{
+		char message[150];
+		sprintf(message, "Parsing \"%s\" succeeded", fen);
+		failTest(message);
+		return;
+	}
+
+	if (error.code != expectedCode || error.offset != expectedOffset)
+	{
+		char message[200];
+		sprintf(message, "Parsing \"%s\" gave \"%s\" at %zu, expected \"%s\" at %zu", fen,
+				fenErrorGetStr(error.code), error.offset, fenErrorGetStr(expectedCode), expectedOffset);
+		failTest(message);
+	}
+}
+
+void testBoardParseFen()
+{
+	board b, bCheck;
+	fenError error;
+
+	// Same as the old parser
+	const char *fen = "r3k2r/p1ppqpb1/bn2pnp1/3PN3/1p2P3/2N2Q1p/PPPBBPPP/R3K2R b Kq e3 12 34";
+	boardInitFromFenInPlace(&bCheck, fen);
+	if (boardParseFen(&b, fen, strlen(fen), &error) || error.code != feNone)
+		failTest("Parsing a good FEN failed");
+	if (!boardEq(&b, &bCheck) || b.halfMoveClock != 12 || b.moveNumber != 34 || b.castleState != (CASTLE_WK | CASTLE_BQ))
+		failTest("Parsed board was wrong");
+	validateBoardBitboards(&b);
+
+	// Only reads as far as it's told, so FENs don't have to be null terminated
+	const char *line = "8/8/8/4k3/8/8/8/4K3 w - - 5 60xyz";
+	if (boardParseFen(&b, line, strlen(line) - 3, NULL) || b.moveNumber != 60)
+		failTest("Parsing part of a line failed");
+
+	// Counters can be left off, and trailing whitespace is fine
+	line = "8/8/8/4k3/8/8/8/4K3 b - -\n";
+	if (boardParseFen(&b, line, strlen(line), &error) || b.halfMoveClock != 0 || b.moveNumber != 1)
+		failTest("Parsing a FEN without counters failed");
+
+	line = "8/8/8/4k3/8/8/8/4K3 b - - 7";
+	if (boardParseFen(&b, line, strlen(line), &error) || b.halfMoveClock != 7 || b.moveNumber != 1)
+		failTest("Parsing a FEN without a move number failed");
+
+	// Huge counters are capped
+	line = "8/8/8/4k3/8/8/8/4K3 b - - 99999999999 1";
+	if (boardParseFen(&b, line, strlen(line), &error) || b.halfMoveClock != UINT16_MAX)
+		failTest("Huge half move clock wasn't capped");
+
+	validateFenError("", feUnexpectedEnd, 0);
+	validateFenError("8/8/8/4k3/8/8/8/4K3", feUnexpectedEnd, 19);
+	validateFenError("8/8/8/4k3/8/8/8/4K3 w", feUnexpectedEnd, 21);
+	validateFenError("8/8/8/4k3/8/8/8/4K3 w KQ", feUnexpectedEnd, 24);
+	validateFenError("8/8/8/4x3/8/8/8/4K3 w - - 0 1", feUnknownPiece, 7);
+	validateFenError("8/8/8/4k4/8/8/8/4K3 w - - 0 1", feRankTooLong, 8);
+	validateFenError("8/8/8/4k3K/8/8/8/4K3 w - - 0 1", feRankTooLong, 9);
+	validateFenError("8/8/8/4k2/8/8/8/4K3 w - - 0 1", feRankTooShort, 9);
+	validateFenError("8/8/8/4k3/8/8/8/4K3/8 w - - 0 1", feTooManyRanks, 19);
+	validateFenError("8/8/4k3/8/8/8/4K3 w - - 0 1", feTooFewRanks, 17);
+	validateFenError("8/8/8/4k3/8/8/8/4K3 x - - 0 1", feBadPlayer, 20);
+	validateFenError("8/8/8/4k3/8/8/8/4K3 wb - - 0 1", feExpectedSpace, 21);
+	validateFenError("8/8/8/4k3/8/8/8/4K3 w  - - 0 1", feBadCastling, 22);
+	validateFenError("8/8/8/4k3/8/8/8/4K3 w KX - 0 1", feBadCastling, 23);
+	validateFenError("8/8/8/4k3/8/8/8/4K3 w - e9 0 1", feBadEpTarget, 24);
+	validateFenError("8/8/8/4k3/8/8/8/4K3 w - - x 1", feBadHalfMoveClock, 26);
+	validateFenError("8/8/8/4k3/8/8/8/4K3 w - - 0 -1", feBadMoveNumber, 28);
+	validateFenError("8/8/8/4k3/8/8/8/4K3 w - - 0 1 bm e4;", feTrailingCharacters, 30);
+}
+
 void testBoardEq()
 {
 	failTest("Not yet implemented");
@@ -440,6 +751,137 @@ void testBoardEq()
 	//board *b1 = boardCreateFromFen("")
 }
 
+void testBoardBitboards()
+{
+	board b;
+
+	// The whole board fits in two cache lines
+	if (sizeof(board) > 128)
+		failTest("The board is bigger than 128 bytes");
+
+	boardInitInPlace(&b);
+	validateBoardBitboards(&b);
+
+	if (boardGetPieceSet(&b, pWPawn) != (sqSet) 0x000000000000FF00)
+		failTest("White pawns were not on the second rank");
+
+	if (boardGetOccupied(&b) != (sqSet) 0xFFFF00000000FFFF)
+		failTest("Occupied squares were not the first two and last two ranks");
+
+	// Play some moves that cover captures, castling, en passant and promotion
+	boardInitFromFenInPlace(&b, "r3k2r/1P6/8/3pP3/8/8/8/R3K2R w KQkq d6 0 1");
+	validateBoardBitboards(&b);
+
+	boardPlayMoveInPlace(&b, moveFromUci("e5d6"));
+	validateBoardBitboards(&b);
+
+	boardPlayMoveInPlace(&b, moveFromUci("e8c8"));
+	validateBoardBitboards(&b);
+
+	boardPlayMoveInPlace(&b, moveFromUci("b7b8q"));
+	validateBoardBitboards(&b);
+
+	boardPlayMoveInPlace(&b, moveFromUci("c8b8"));
+	validateBoardBitboards(&b);
+
+	boardPlayMoveInPlace(&b, moveFromUci("e1g1"));
+	validateBoardBitboards(&b);
+
+	// Reinitializing over a used board should not leave anything behind
+	boardInitFromFenInPlace(&b, "8/4k3/8/8/2K5/8/8/8 w - - 0 1");
+	validateBoardBitboards(&b);
+}
+
+
+// HELPER - validates that the incrementally updated hash matches the hash of the same position loaded from FEN
+void validateBoardHashFromFen(board *b)
+{
+	char *fen = boardGetFen(b);
+	board fromFen;
+	boardInitFromFenInPlace(&fromFen, fen);
+
+	if (boardGetHash(b) != boardGetHash(&fromFen))
+	{
+		char message[120];
+		sprintf(message, "Incremental hash didn't match the hash from FEN \"%s\"", fen);
+		failTest(message);
+	}
+
+	free(fen);
+}
+
+void testBoardHash()
+{
+	board b1;
+	board b2;
+	moveBuffer buf;
+
+	// Play a long, varied sequence of moves and check the hash after every one
+	boardInitFromFenInPlace(&b1, "r3k2r/p1ppqpb1/bn2pnp1/3PN3/1p2P3/2N2Q1p/PPPBBPPP/R3K2R w KQkq - 0 1");
+	for (int i = 0; i < 200; i++)
+	{
+		boardGenerateMovesInto(&b1, &buf);
+		if (buf.size == 0)
+			break;
+		boardPlayMoveInPlace(&b1, moveBufferGet(&buf, (i * 7 + 3) % buf.size));
+		validateBoardHashFromFen(&b1);
+	}
+
+	// Transpositions hash the same
+	boardInitInPlace(&b1);
+	boardPlayMoveInPlace(&b1, moveFromUci("g1f3"));
+	boardPlayMoveInPlace(&b1, moveFromUci("g8f6"));
+	boardPlayMoveInPlace(&b1, moveFromUci("b1c3"));
+
+	boardInitInPlace(&b2);
+	boardPlayMoveInPlace(&b2, moveFromUci("b1c3"));
+	boardPlayMoveInPlace(&b2, moveFromUci("g8f6"));
+	boardPlayMoveInPlace(&b2, moveFromUci("g1f3"));
+
+	if (boardGetHash(&b1) != boardGetHash(&b2))
+		failTest("Transposed positions had different hashes");
+
+	// Player to move, castling rights matter
+	boardInitFromFenInPlace(&b1, "r3k2r/8/8/8/8/8/8/R3K2R w KQkq - 0 1");
+	boardInitFromFenInPlace(&b2, "r3k2r/8/8/8/8/8/8/R3K2R b KQkq - 0 1");
+	if (boardGetHash(&b1) == boardGetHash(&b2))
+		failTest("Different players to move had the same hash");
+
+	boardInitFromFenInPlace(&b2, "r3k2r/8/8/8/8/8/8/R3K2R w Kkq - 0 1");
+	if (boardGetHash(&b1) == boardGetHash(&b2))
+		failTest("Different castling rights had the same hash");
+
+	// The EP target square only matters if the capture is possible
+	boardInitFromFenInPlace(&b1, "4k3/8/8/8/4P3/8/8/4K3 b - e3 0 1");
+	boardInitFromFenInPlace(&b2, "4k3/8/8/8/4P3/8/8/4K3 b - - 0 1");
+	if (boardGetHash(&b1) != boardGetHash(&b2))
+		failTest("Impossible EP capture changed the hash");
+
+	boardInitFromFenInPlace(&b1, "4k3/8/8/8/3pP3/8/8/4K3 b - e3 0 1");
+	boardInitFromFenInPlace(&b2, "4k3/8/8/8/3pP3/8/8/4K3 b - - 0 1");
+	if (boardGetHash(&b1) == boardGetHash(&b2))
+		failTest("Possible EP capture didn't change the hash");
+
+	// EP capture that would expose the king along the rank
+	boardInitFromFenInPlace(&b1, "8/8/8/8/k2pP2R/8/8/4K3 b - e3 0 1");
+	boardInitFromFenInPlace(&b2, "8/8/8/8/k2pP2R/8/8/4K3 b - - 0 1");
+	if (boardGetHash(&b1) != boardGetHash(&b2))
+		failTest("Illegal EP capture changed the hash");
+
+	// Setting a piece that changes whether EP can be captured keeps the hash up to date
+	boardInitFromFenInPlace(&b1, "4k3/8/8/3pP3/8/8/8/4K3 w - d6 0 1");
+	boardSetPiece(&b1, sqS("e5"), pEmpty);
+	validateBoardHashFromFen(&b1);
+	boardPlayMoveInPlace(&b1, moveFromUci("e1e2"));
+	validateBoardHashFromFen(&b1);
+	boardInitFromFenInPlace(&b2, "4k3/8/8/3p4/8/8/4K3/8 b - - 1 1");
+	if (!boardEq(&b1, &b2) || !boardEqContext(&b1, &b2))
+		failTest("Board with a piece set didn't equal the same position from FEN");
+
+	boardInitFromFenInPlace(&b1, "4k3/8/8/3p4/8/8/8/4K3 w - d6 0 1");
+	boardSetPiece(&b1, sqS("e5"), pWPawn);
+	validateBoardHashFromFen(&b1);
+}
 
 /////////////////////
 // TEST PIECEMOVES //
@@ -448,9 +890,9 @@ void testBoardEq()
 // Helper function - checks if given UCI string exists in moveList
 void validateUciIsInMovelist(moveList *list, char *expectedUci)
 {
-	for (moveListNode *n = list->head; n; n = n->next)
+	for (size_t i = 0; i < list->size; i++)
 	{
-		char *actualUci = moveGetUci(n->move);
+		char *actualUci = moveGetUci(moveListGet(list, i));
 		int cmp = strcmp(actualUci, expectedUci);
 		free(actualUci);
 		if (cmp == 0)
@@ -848,6 +1290,73 @@ void testKingMoves()
 	moveListFree(list);
 }
 
+// HELPER - walks the rays from a square the slow way, to check the attack tables against
+sqSet slowSliderAttackSet(uint8_t index, sqSet occupied, int8_t dirs[][2], int numDirs)
+{
+	sqSet attacks = 0;
+	for (int i = 0; i < numDirs; i++)
+	{
+		int file = index % 8 + dirs[i][0];
+		int rank = index / 8 + dirs[i][1];
+		while (file >= 0 && file < 8 && rank >= 0 && rank < 8)
+		{
+			attacks |= (sqSet) 1 << (8 * rank + file);
+			if ((occupied >> (8 * rank + file)) & 1)
+				break;
+			file += dirs[i][0];
+			rank += dirs[i][1];
+		}
+	}
+	return attacks;
+}
+
+void testSliderAttackSets()
+{
+	int8_t diagonals[4][2] = {{1, 1}, {1, -1}, {-1, -1}, {-1, 1}};
+	int8_t orthogonals[4][2] = {{0, 1}, {1, 0}, {0, -1}, {-1, 0}};
+
+	// Deterministic pseudo-random occupancies of varying density
+	uint64_t state = 0x9E3779B97F4A7C15;
+	for (int trial = 0; trial < 300; trial++)
+	{
+		sqSet occupied = ~((sqSet) 0);
+		for (int j = 0; j < (trial % 4) + 1; j++)
+		{
+			state ^= state << 13;
+			state ^= state >> 7;
+			state ^= state << 17;
+			occupied &= state;
+		}
+
+		for (uint8_t index = 0; index < 64; index++)
+		{
+			sqSet expectedBishop = slowSliderAttackSet(index, occupied, diagonals, 4);
+			sqSet expectedRook = slowSliderAttackSet(index, occupied, orthogonals, 4);
+
+			if (pmGetBishopAttackSet(index, occupied) != expectedBishop)
+			{
+				char message[60];
+				sprintf(message, "Bishop attack set on %s was wrong", sqGetStr(sqIndex(index)));
+				failTest(message);
+			}
+
+			if (pmGetRookAttackSet(index, occupied) != expectedRook)
+			{
+				char message[60];
+				sprintf(message, "Rook attack set on %s was wrong", sqGetStr(sqIndex(index)));
+				failTest(message);
+			}
+
+			if (pmGetQueenAttackSet(index, occupied) != (expectedBishop | expectedRook))
+			{
+				char message[60];
+				sprintf(message, "Queen attack set on %s was wrong", sqGetStr(sqIndex(index)));
+				failTest(message);
+			}
+		}
+	}
+}
+
 
 /////////////////////////////////////
 // TEST ATTACKED SQUARES AND CHECK //
@@ -950,6 +1459,70 @@ void testIsInCheck()
 }
 
 
+void testBoardAttackersOf()
+{
+	board b;
+	boardInitFromFenInPlace(&b, "B7/8/8/5p2/7q/3P4/k3PN2/4R2K w - - 0 1");
+
+	// The rook on e1 is blocked by the pawn on e2
+	sqSet expected = 0;
+	sqSetSet(&expected, sqS("a8"), 1);
+	sqSetSet(&expected, sqS("d3"), 1);
+	sqSetSet(&expected, sqS("f2"), 1);
+
+	if (boardAttackersOf(&b, sqS("e4"), pcWhite) != expected)
+		failTest("White attackers of e4 were wrong");
+
+	expected = 0;
+	sqSetSet(&expected, sqS("h4"), 1);
+	sqSetSet(&expected, sqS("f5"), 1);
+
+	if (boardAttackersOf(&b, sqS("e4"), pcBlack) != expected)
+		failTest("Black attackers of e4 were wrong");
+
+	// Defenders are included too
+	expected = 0;
+	sqSetSet(&expected, sqS("e1"), 1);
+
+	if (boardAttackersOf(&b, sqS("e2"), pcWhite) != expected)
+		failTest("White defenders of e2 were wrong");
+
+	if (boardIsSquareAttacked(&b, sqS("e2"), pcWhite))
+		failTest("e2 was attacked by white, but it's occupied by white");
+}
+
+void testBoardGetKingSquare()
+{
+	board b;
+
+	boardInitFromFenInPlace(&b, INITIAL_FEN);
+	if (!sqEq(boardGetKingSquare(&b, pcWhite), sqS("e1")) || !sqEq(boardGetKingSquare(&b, pcBlack), sqS("e8")))
+		failTest("Kings weren't found on their starting squares");
+
+	// Follows the king when it moves
+	boardPlayMoveInPlace(&b, moveFromUci("e2e4"));
+	boardPlayMoveInPlace(&b, moveFromUci("e7e5"));
+	boardPlayMoveInPlace(&b, moveFromUci("e1e2"));
+	if (!sqEq(boardGetKingSquare(&b, pcWhite), sqS("e2")))
+		failTest("King wasn't found after moving");
+
+	// And when castling
+	boardInitFromFenInPlace(&b, "r3k2r/8/8/8/8/8/8/R3K2R b KQkq - 0 1");
+	boardPlayMoveInPlace(&b, moveFromUci("e8c8"));
+	if (!sqEq(boardGetKingSquare(&b, pcBlack), sqS("c8")))
+		failTest("King wasn't found after castling");
+
+	// No king, or more than one
+	boardInitFromFenInPlace(&b, "4k3/8/8/8/8/8/8/1K2K3 w - - 0 1");
+	if (!sqEq(boardGetKingSquare(&b, pcWhite), SQ_INVALID))
+		failTest("Found a single king when there were two");
+
+	boardInitFromFenInPlace(&b, "8/8/8/8/8/8/8/4K3 w - - 0 1");
+	if (!sqEq(boardGetKingSquare(&b, pcBlack), SQ_INVALID))
+		failTest("Found a king that wasn't there");
+}
+
+
 ////////////////////////
 // TEST PLAYING MOVES //
 ////////////////////////
@@ -1081,11 +1654,68 @@ void testBoardPlayMove()
 
 	validateBoardEq("Black EP - capture", b, bCheck);
 
+	// The counters stop at the largest value a FEN can give them instead of wrapping back to 0
+	boardInitFromFenInPlace(b, "4k3/8/8/8/8/8/8/R3K3 b - - 65535 65535");
+
+	boardPlayMoveInPlace(b, moveFromUci("e8d8"));
+	boardInitFromFenInPlace(bCheck, "3k4/8/8/8/8/8/8/R3K3 w - - 65535 65535");
+
+	validateBoardEq("Counters at their limit", b, bCheck);
+
 	// Free boards
 	free(b);
 	free(bCheck);
 }
 
+// HELPER - checks every move in the position with make/unmake against copy-make
+void checkMakeUnmake(board *b)
+{
+	moveBuffer buf;
+	boardGenerateMovesInto(b, &buf);
+
+	board before;
+	memcpy(&before, b, sizeof(board));
+
+	char uci[UCI_MAX_LENGTH];
+	char message[80];
+	for (size_t i = 0; i < buf.size; i++)
+	{
+		move m = moveBufferGet(&buf, i);
+		board played;
+		memcpy(&played, &before, sizeof(board));
+		boardPlayMoveInPlace(&played, m);
+
+		undoInfo undo;
+		boardMakeMove(b, m, &undo);
+		if (!boardEq(b, &played) || boardGetHash(b) != boardGetHash(&played))
+		{
+			moveWriteUci(m, uci);
+			sprintf(message, "Making %s did not match playing it", uci);
+			failTest(message);
+		}
+
+		boardUnmakeMove(b, m, &undo);
+		if (!boardEq(b, &before) || boardGetHash(b) != boardGetHash(&before))
+		{
+			moveWriteUci(m, uci);
+			sprintf(message, "Unmaking %s did not restore the board", uci);
+			failTest(message);
+		}
+		validateBoardBitboards(b);
+	}
+}
+
+void testBoardMakeUnmakeMove()
+{
+	// Castling, promotions, en passant and captures of castling rooks all need undoing
+	walkReferencePositions(2, checkMakeUnmake);
+
+	// Unmaking has to put back counters that couldn't go any higher
+	board b;
+	boardInitFromFenInPlace(&b, "4k3/8/8/8/8/8/8/R3K3 b - - 65535 65535");
+	walkPositions(&b, 2, checkMakeUnmake);
+}
+
 
 ////////////////////////////////
 // TEST BOARD MOVE GENERATION //
@@ -1094,9 +1724,9 @@ void testBoardPlayMove()
 // Helper function - asserts that given UCI string does NOT in moveList. For castling tests
 void validateUciIsNotInMovelist(moveList *list, char *expectedUci)
 {
-	for (moveListNode *n = list->head; n; n = n->next)
+	for (size_t i = 0; i < list->size; i++)
 	{
-		char *actualUci = moveGetUci(n->move);
+		char *actualUci = moveGetUci(moveListGet(list, i));
 		int cmp = strcmp(actualUci, expectedUci);
 		free(actualUci);
 		if (cmp == 0)
@@ -1378,6 +2008,239 @@ void testBoardGenerateMovesCastling()
 	moveListFree(list);
 }
 
+// HELPER - validates the number of moves in a buffer
+void validateBufferSize(moveBuffer *buf, size_t expectedSize)
+{
+	if (buf->size != expectedSize)
+	{
+		char message[70];
+		sprintf(message, "Actual buffer was %zu element(s), expected %zu", buf->size, expectedSize);
+		failTest(message);
+	}
+}
+
+void testBoardGenerateMovesInto()
+{
+	board b;
+	moveBuffer buf;
+
+	// Initial board
+	boardInitInPlace(&b);
+	boardGenerateMovesInto(&b, &buf);
+
+	validateBufferSize(&buf, 20);
+	if (!moveBufferContains(&buf, moveFromUci("e2e4")))
+		failTest("e2e4 was not in the buffer");
+	if (!moveBufferContains(&buf, moveFromUci("g1f3")))
+		failTest("g1f3 was not in the buffer");
+
+	// The buffer is cleared before being filled
+	boardGenerateMovesInto(&b, &buf);
+	validateBufferSize(&buf, 20);
+
+	// "Kiwipete" - castling, en passant captures, pins and checks
+	boardInitFromFenInPlace(&b, "r3k2r/p1ppqpb1/bn2pnp1/3PN3/1p2P3/2N2Q1p/PPPBBPPP/R3K2R w KQkq - 0 1");
+	boardGenerateMovesInto(&b, &buf);
+	validateBufferSize(&buf, 48);
+
+	// Promotions and a discovered check
+	boardInitFromFenInPlace(&b, "rnbq1k1r/pp1Pbppp/2p5/8/2B5/8/PPP1NnPP/RNBQK2R w KQ - 1 8");
+	boardGenerateMovesInto(&b, &buf);
+	validateBufferSize(&buf, 44);
+	if (!moveBufferContains(&buf, moveFromUci("d7c8n")))
+		failTest("d7c8n was not in the buffer");
+
+	// In check, only a few evasions
+	boardInitFromFenInPlace(&b, "r3k2r/Pppp1ppp/1b3nbN/nP6/BBP1P3/q4N2/Pp1P2PP/R2Q1RK1 w kq - 0 1");
+	boardGenerateMovesInto(&b, &buf);
+	validateBufferSize(&buf, 6);
+
+	// En passant capture that would expose the king is not allowed
+	boardInitFromFenInPlace(&b, "8/8/8/KPp4r/8/8/8/7k w - c6 0 1");
+	boardGenerateMovesInto(&b, &buf);
+	if (moveBufferContains(&buf, moveFromUci("b5c6")))
+		failTest("b5c6 was in the buffer, but it exposes the king");
+}
+
+void testBoardGenerateMovesPinsAndChecks()
+{
+	board b;
+	moveBuffer buf;
+
+	// Pinned rook can only move along the pin
+	boardInitFromFenInPlace(&b, "4k3/4r3/8/8/8/8/4R3/4K3 w - - 0 1");
+	boardGenerateMovesInto(&b, &buf);
+	validateBufferSize(&buf, 9);
+	if (!moveBufferContains(&buf, moveFromUci("e2e7")))
+		failTest("e2e7 was not in the buffer");
+	if (moveBufferContains(&buf, moveFromUci("e2d2")))
+		failTest("e2d2 was in the buffer, but the rook is pinned");
+
+	// Double check, only the king can move
+	boardInitFromFenInPlace(&b, "4k3/8/8/8/8/5n2/8/r3K3 w - - 0 1");
+	boardGenerateMovesInto(&b, &buf);
+	validateBufferSize(&buf, 2);
+	if (!moveBufferContains(&buf, moveFromUci("e1e2")) || !moveBufferContains(&buf, moveFromUci("e1f2")))
+		failTest("The king's escapes were not in the buffer");
+
+	// Bishop pinned along a file can't move at all
+	boardInitFromFenInPlace(&b, "8/8/3k4/8/3q4/8/3B4/3K4 w - - 0 1");
+	boardGenerateMovesInto(&b, &buf);
+	validateBufferSize(&buf, 4);
+	if (moveBufferContains(&buf, moveFromUci("d2e3")))
+		failTest("d2e3 was in the buffer, but the bishop is pinned");
+
+	// En passant capture of the checking pawn
+	boardInitFromFenInPlace(&b, "8/8/8/2k5/3Pp3/8/8/4K3 b - d3 0 1");
+	boardGenerateMovesInto(&b, &buf);
+	validateBufferSize(&buf, 9);
+	if (!moveBufferContains(&buf, moveFromUci("e4d3")))
+		failTest("e4d3 was not in the buffer");
+	if (moveBufferContains(&buf, moveFromUci("e4e3")))
+		failTest("e4e3 was in the buffer, but it doesn't get out of check");
+}
+
+// HELPER - checks boardCountLegalMoves and boardHasLegalMove against the generator
+void checkLegalMoveCount(board *b)
+{
+	moveBuffer buf;
+	boardGenerateMovesInto(b, &buf);
+
+	if (boardCountLegalMoves(b) != buf.size || boardHasLegalMove(b) != (buf.size > 0))
+	{
+		char fen[FEN_MAX_LENGTH];
+		boardWriteFen(b, fen, sizeof(fen));
+		char message[150];
+		sprintf(message, "Counted %zu legal moves in %s, generated %zu", boardCountLegalMoves(b), fen, buf.size);
+		failTest(message);
+	}
+}
+
+void testBoardCountLegalMoves()
+{
+	board b;
+
+	walkReferencePositions(2, checkLegalMoveCount);
+
+	boardInitFromFenInPlace(&b, "rnb1kbnr/pppp1ppp/8/4p3/6Pq/5P2/PPPPP2P/RNBQKBNR w KQkq - 1 3");
+	if (boardHasLegalMove(&b))
+		failTest("Checkmated side had a legal move");
+
+	boardInitFromFenInPlace(&b, "7k/5Q2/8/8/8/8/8/K7 b - - 0 1");
+	if (boardHasLegalMove(&b))
+		failTest("Stalemated side had a legal move");
+}
+
+// HELPER - checks boardIsMoveLegal against the generator for every possible move
+void checkIsMoveLegal(board *b)
+{
+	moveBuffer buf;
+	boardGenerateMovesInto(b, &buf);
+
+	for (uint8_t from = 0; from < 64; from++)
+	{
+		for (uint8_t to = 0; to < 64; to++)
+		{
+			for (pieceType pt = ptEmpty; pt <= ptKing; pt++)
+			{
+				move m = movePromote(sqIndex(from), sqIndex(to), pt);
+				if (boardIsMoveLegal(b, m) != moveBufferContains(&buf, m))
+				{
+					char fen[FEN_MAX_LENGTH];
+					char uci[UCI_MAX_LENGTH];
+					boardWriteFen(b, fen, sizeof(fen));
+					moveWriteUci(m, uci);
+					char message[150];
+					sprintf(message, "boardIsMoveLegal got %s wrong in %s", uci, fen);
+					failTest(message);
+				}
+			}
+		}
+	}
+}
+
+void testBoardIsMoveLegal()
+{
+	board b;
+
+	walkReferencePositions(1, checkIsMoveLegal);
+
+	// Moves that don't make sense at all
+	boardInitFromFenInPlace(&b, INITIAL_FEN);
+	if (boardIsMoveLegal(&b, moveSq(SQ_INVALID, sqI(5, 4))))
+		failTest("Move from an invalid square was legal");
+	if (boardIsMoveLegal(&b, moveFromUci("e2e4q")))
+		failTest("Pawn promoted on the fourth rank");
+	if (boardIsMoveLegal(&b, moveFromUci("e7e5")))
+		failTest("White moved a black pawn");
+}
+
+// HELPER - checks that the staged generators split up the full set of legal moves correctly
+void checkGenerateStages(board *b)
+{
+	moveBuffer all, captures, quiets, evasions;
+	boardGenerateMovesInto(b, &all);
+	boardGenerateCaptures(b, &captures);
+	boardGenerateQuiets(b, &quiets);
+	boardGenerateEvasions(b, &evasions);
+
+	char fen[FEN_MAX_LENGTH];
+	boardWriteFen(b, fen, sizeof(fen));
+	char message[150];
+
+	if (captures.size + quiets.size != all.size)
+	{
+		sprintf(message, "%zu captures and %zu quiets don't add up to %zu moves in %s",
+				captures.size, quiets.size, all.size, fen);
+		failTest(message);
+	}
+
+	for (size_t i = 0; i < all.size; i++)
+	{
+		move m = moveBufferGet(&all, i);
+		uint8_t isCapture = m.promotion != ptEmpty || boardGetPiece(b, m.to) != pEmpty
+				|| (pieceGetType(boardGetPiece(b, m.from)) == ptPawn && sqEq(m.to, b->epTarget));
+
+		if (!moveBufferContains(isCapture ? &captures : &quiets, m))
+		{
+			char uci[UCI_MAX_LENGTH];
+			moveWriteUci(m, uci);
+			sprintf(message, "%s was not in the %s in %s", uci, isCapture ? "captures" : "quiets", fen);
+			failTest(message);
+		}
+	}
+
+	if (evasions.size != (boardIsInCheck(b) ? all.size : 0))
+	{
+		sprintf(message, "Generated %zu evasions in %s", evasions.size, fen);
+		failTest(message);
+	}
+}
+
+void testBoardGenerateStages()
+{
+	board b;
+
+	walkReferencePositions(2, checkGenerateStages);
+
+	// Promotions that don't get out of check aren't generated as captures, the king moves are the only evasions
+	moveBuffer buf;
+	boardInitFromFenInPlace(&b, "4k3/1P6/8/8/8/8/8/4K2r w - - 0 1");
+	boardGenerateCaptures(&b, &buf);
+	if (moveBufferContains(&buf, moveFromUci("b7b8n")))
+		failTest("b7b8n was a capture while in check");
+	boardGenerateEvasions(&b, &buf);
+	if (!moveBufferContains(&buf, moveFromUci("e1d2")) || moveBufferContains(&buf, moveFromUci("e1f1")))
+		failTest("Evasions were wrong");
+
+	// Out of check, a promotion is a capture even when nothing is taken
+	boardInitFromFenInPlace(&b, "4k3/1P6/8/8/8/8/8/4K3 w - - 0 1");
+	boardGenerateCaptures(&b, &buf);
+	validateBufferSize(&buf, 4);
+	if (!moveBufferContains(&buf, moveFromUci("b7b8n")))
+		failTest("b7b8n was not in the captures");
+}
+
 
 /////////////////////////
 // TEST FEN GENERATION //
@@ -1404,6 +2267,32 @@ void testBoardGetFen()
 	validateBoardFen("r1q1k2r/8/8/8/3P4/8/8/R3K2R b Kq d3 0 1"); 	// Misc setup, varying castling states, EP
 }
 
+void testBoardWriteFen()
+{
+	board b;
+	char buf[FEN_MAX_LENGTH];
+
+	const char *fen = "r3r1k1/pp3pbp/1qp1b1p1/2B5/2BP4/Q1n2N2/P4PPP/3R1K1R w - - 4 18";
+	boardInitFromFenInPlace(&b, fen);
+	if (boardWriteFen(&b, buf, sizeof(buf)) != strlen(fen))
+		failTest("boardWriteFen returned the wrong length");
+	validateString(buf, fen);
+
+	// Very long FENs still fit
+	const char *longFen = "rp1pkp1r/1p1p1p1p/p1p1p1p1/1p1p1p1p/P1P1P1P1/1P1P1P1P/P1P1P1P1/R1P1K2R b KQkq a3 65535 65535";
+	boardInitFromFenInPlace(&b, longFen);
+	if (boardWriteFen(&b, buf, sizeof(buf)) != strlen(longFen))
+		failTest("boardWriteFen returned the wrong length for a long FEN");
+	validateString(buf, longFen);
+
+	// Too small a buffer gets as much as fits
+	boardInitFromFenInPlace(&b, fen);
+	char small[11];
+	if (boardWriteFen(&b, small, sizeof(small)) != strlen(fen))
+		failTest("boardWriteFen didn't return the full length when cut short");
+	validateString(small, "r3r1k1/pp3");
+}
+
 
 ////////////////////////////////////////
 // TEST DRAW BY INSUFFICIENT MATERIAL //
@@ -1454,6 +2343,45 @@ void testBoardIsInsufficientMaterial()
 	// K+B+B+B+B vs K+B+B+B, all same colors, true
 	boardInitFromFenInPlace(&b, "3b4/4k1b1/5b2/8/1BK5/6B1/3B1B2/8 w - - 0 1");
 	validateBoardIsInsufficientMaterial(&b, 1);
+
+	// K+B+P vs K+B, same colors, false until the pawn is taken
+	boardInitFromFenInPlace(&b, "8/4kb2/6P1/8/2K5/8/4B3/8 b - - 0 1");
+	validateBoardIsInsufficientMaterial(&b, 0);
+	boardPlayMoveInPlace(&b, moveFromUci("f7g6"));
+	validateBoardIsInsufficientMaterial(&b, 1);
+}
+
+void testBoardMaterialKey()
+{
+	board b1, b2;
+
+	// Same material in different places
+	boardInitFromFenInPlace(&b1, "8/4kb2/8/8/2K5/6B1/8/8 w - - 0 1");
+	boardInitFromFenInPlace(&b2, "4k3/8/8/1b6/8/4B3/8/K7 b - - 0 1");
+	if (boardGetMaterialKey(&b1) != boardGetMaterialKey(&b2))
+		failTest("Same material had different keys");
+
+	// Bishops on the other color aren't the same material
+	boardInitFromFenInPlace(&b2, "8/4k1b1/8/8/2K5/6B1/8/8 w - - 0 1");
+	if (boardGetMaterialKey(&b1) == boardGetMaterialKey(&b2))
+		failTest("Bishops on different colors had the same key");
+
+	// The key follows captures and promotions
+	boardInitFromFenInPlace(&b1, "1r2k3/P7/8/8/8/8/8/4K3 w - - 0 1");
+	boardInitFromFenInPlace(&b2, "1N2k3/8/8/8/8/8/8/4K3 b - - 0 1");
+	boardPlayMoveInPlace(&b1, moveFromUci("a7b8n"));
+	if (boardGetMaterialKey(&b1) != boardGetMaterialKey(&b2))
+		failTest("Key was wrong after a capturing promotion");
+	validateBoardBitboards(&b1);
+
+	boardInitInPlace(&b1);
+	uint64_t expected = ((uint64_t) 8 << (4 * pWPawn)) | ((uint64_t) 2 << (4 * pWKnight)) | ((uint64_t) 1 << (4 * pWBishop))
+			| ((uint64_t) 2 << (4 * pWRook)) | ((uint64_t) 1 << (4 * pWQueen)) | ((uint64_t) 1 << (4 * pWKing))
+			| ((uint64_t) 8 << (4 * pBPawn)) | ((uint64_t) 2 << (4 * pBKnight)) | ((uint64_t) 1 << (4 * pBBishop))
+			| ((uint64_t) 2 << (4 * pBRook)) | ((uint64_t) 1 << (4 * pBQueen)) | ((uint64_t) 1 << (4 * pBKing))
+			| ((uint64_t) 1 << (4 * MATERIAL_W_DARK_BISHOP)) | ((uint64_t) 1 << (4 * MATERIAL_B_DARK_BISHOP));
+	if (boardGetMaterialKey(&b1) != expected)
+		failTest("Key of the initial position was wrong");
 }
 
 
@@ -1463,26 +2391,48 @@ void testBoardIsInsufficientMaterial()
 
 void testBoardList()
 {
-	board *b1 = boardCreate();
-	board *b2 = boardPlayMove(b1, moveFromUci("e2e4"));
-	board *b3 = boardPlayMove(b1, moveFromUci("c7c5"));
+	board b1;
+	board b2;
+	board b3;
+	boardInitInPlace(&b1);
+	boardInitFromFenInPlace(&b2, "rnbqkbnr/pppppppp/8/8/4P3/8/PPPP1PPP/RNBQKBNR b KQkq e3 0 1");
+	boardInitFromFenInPlace(&b3, "rnbqkbnr/pp1ppppp/8/2p5/8/8/PPPPPPPP/RNBQKBNR w KQkq c6 0 1");
 
 	boardList *l = boardListCreate();
 
-	boardListAdd(l, b1);
-	boardListAdd(l, b2);
-	boardListAdd(l, b3);
+	// Boards are copied in
+	boardListAddCopy(l, &b1);
+	boardListAddCopy(l, &b2);
+	boardListAddCopy(l, &b3);
+
+	if (boardListGet(l, 0) == &b1 || !boardEq(boardListGet(l, 0), &b1))
+		failTest("boardListGet(l, 0) didn't return a copy of b1");
 
-	if (boardListGet(l, 0) != b1)
-		failTest("boardListGet(l, 0) didn't return b1");
+	if (!boardEq(boardListGet(l, 1), &b2))
+		failTest("boardListGet(l, 1) didn't return a copy of b2");
 
-	if (boardListGet(l, 1) != b2)
-		failTest("boardListGet(l, 1) didn't return b2");
+	if (!boardEq(boardListGet(l, 2), &b3))
+		failTest("boardListGet(l, 2) didn't return a copy of b3");
 
-	if (boardListGet(l, 2) != b3)
-		failTest("boardListGet(l, 2) didn't return b3");
+	// Undo drops the last board and leaves the rest
+	boardListUndo(l);
+	if (l->size != 2 || !boardEq(boardListGet(l, 1), &b2))
+		failTest("boardListUndo didn't remove just the last board");
+
+	// The next board starts as a copy of the last one, ready to play a move on
+	board *next = boardListAddNext(l);
+	if (l->size != 3 || next != boardListGet(l, 2) || !boardEq(next, &b2))
+		failTest("boardListAddNext didn't add a copy of the last board");
+	boardPlayMoveInPlace(next, moveFromUci("c7c5"));
+	if (!boardEq(boardListGet(l, 1), &b2))
+		failTest("Playing a move on the next board changed the one before it");
+
+	// Growing past the initial capacity should keep every board
+	for (int i = 0; i < 100; i++)
+		boardListAddCopy(l, &b3);
+	if (l->size != 103 || !boardEq(boardListGet(l, 0), &b1) || !boardEq(boardListGet(l, 102), &b3))
+		failTest("boardList lost boards while growing");
 
-	// This also frees all boards
 	boardListFree(l);
 }
 
@@ -1531,7 +2481,7 @@ void testSqSetGet()
 		if (expected != actual)
 		{
 			char message[100];
-			sprintf("Square %s was %d in the set, expected %d", sqGetStr(s), actual, expected);
+			sprintf(message, "Square %s was %d in the set, expected %d", sqGetStr(s), actual, expected);
 			failTest(message);
 		}
 	}
@@ -1549,8 +2499,821 @@ void testSqSetGet()
 		if (expected != actual)
 		{
 			char message[100];
-			sprintf("Square %s was %d in the set, expected %d", sqGetStr(s), actual, expected);
+			sprintf(message, "Square %s was %d in the set, expected %d", sqGetStr(s), actual, expected);
 			failTest(message);
 		}
 	}
 }
+
+
+////////////////
+// TEST PERFT //
+////////////////
+
+// HELPER - validates the perft count of a FEN
+void validatePerft(const char *fen, unsigned int depth, uint64_t expected)
+{
+	board b;
+	boardInitFromFenInPlace(&b, fen);
+	uint64_t actual = perft(&b, depth);
+	if (actual != expected)
+	{
+		char message[100];
+		sprintf(message, "Perft %u was %llu, expected %llu", depth, (unsigned long long) actual,
+				(unsigned long long) expected);
+		failTest(message);
+	}
+}
+
+void testPerft()
+{
+	validatePerft(INITIAL_FEN, 0, 1);
+	validatePerft(INITIAL_FEN, 1, 20);
+	validatePerft(INITIAL_FEN, 3, 8902);
+	validatePerft("r3k2r/p1ppqpb1/bn2pnp1/3PN3/1p2P3/2N2Q1p/PPPBBPPP/R3K2R w KQkq - 0 1", 3, 97862);
+	validatePerft("8/2p5/3p4/KP5r/1R3p1k/8/4P1P1/8 w - - 0 1", 4, 43238);
+	validatePerft("r3k2r/Pppp1ppp/1b3nbN/nP6/BBP1P3/q4N2/Pp1P2PP/R2Q1RK1 w kq - 0 1", 3, 9467);
+	validatePerft("rnbq1k1r/pp1Pbppp/2p5/8/2B5/8/PPP1NnPP/RNBQK2R w KQ - 1 8", 3, 62379);
+
+	// Divide should add up to the same total
+	board b;
+	moveBuffer moves;
+	uint64_t counts[MOVE_BUFFER_CAPACITY];
+	boardInitFromFenInPlace(&b, "r3k2r/p1ppqpb1/bn2pnp1/3PN3/1p2P3/2N2Q1p/PPPBBPPP/R3K2R w KQkq - 0 1");
+
+	uint64_t total = perftDivide(&b, 2, &moves, counts);
+	if (total != 2039 || moves.size != 48)
+		failTest("Perft divide total was wrong");
+
+	uint64_t sum = 0;
+	for (size_t i = 0; i < moves.size; i++)
+		sum += counts[i];
+	if (sum != total)
+		failTest("Perft divide counts did not add up to the total");
+
+	// Parallel perft should agree for any split
+	if (perftParallel(&b, 3, 4, 1) != 97862)
+		failTest("Parallel perft split at 1 ply was wrong");
+
+	if (perftParallel(&b, 3, 3, 2) != 97862)
+		failTest("Parallel perft split at 2 plies was wrong");
+
+	if (perftParallel(&b, 2, 4, 2) != 2039)
+		failTest("Parallel perft with nothing to split was wrong");
+}
+
+
+/////////////////////
+// TEST CHESS GAME //
+/////////////////////
+
+// HELPER - plays the given UCI moves, separated by spaces, failing if any are illegal
+void playUciMoves(chess *c, const char *moves)
+{
+	char uci[6];
+	while (*moves)
+	{
+		int len = 0;
+		while (*moves && *moves != ' ' && len < 5)
+			uci[len++] = *moves++;
+		uci[len] = 0;
+		while (*moves == ' ')
+			moves++;
+
+		if (chessPlayMove(c, moveFromUci(uci)))
+		{
+			char message[40];
+			sprintf(message, "Move %s was illegal", uci);
+			failTest(message);
+		}
+	}
+}
+
+void validateRepetitions(chess *c, uint8_t expected)
+{
+	if (chessGetRepetitions(c) != expected)
+	{
+		char message[60];
+		sprintf(message, "Position was seen %u time(s), expected %u", chessGetRepetitions(c), expected);
+		failTest(message);
+	}
+}
+
+void testChessRepetitions()
+{
+	chess *c = chessCreate();
+
+	playUciMoves(c, "g1f3 g8f6 f3g1 f6g8");
+	validateRepetitions(c, 2);
+
+	playUciMoves(c, "g1f3 g8f6 f3g1 f6g8");
+	validateRepetitions(c, 3);
+	if (!chessCanClaimDrawThreefold(c))
+		failTest("Couldn't claim threefold repetition");
+
+	// Undoing goes back to fewer repetitions
+	chessUndo(c);
+	validateRepetitions(c, 2);
+	playUciMoves(c, "f6g8");
+	validateRepetitions(c, 3);
+
+	playUciMoves(c, "g1f3 g8f6 f3g1 f6g8 g1f3 g8f6 f3g1 f6g8");
+	validateRepetitions(c, 5);
+	if (chessGetTerminalState(c) != tsDrawFivefold)
+		failTest("Game was not drawn by fivefold repetition");
+
+	chessFree(c);
+
+	// A pawn move means nothing before it can repeat
+	c = chessCreate();
+	playUciMoves(c, "g1f3 g8f6 f3g1 f6g8 e2e3 e7e6 g1f3 g8f6 f3g1 f6g8");
+	validateRepetitions(c, 2);
+	chessFree(c);
+
+	// An EP target square that can't be captured on doesn't make a position different
+	c = chessCreateFen("4k3/8/8/8/8/8/4P3/4K3 w - - 0 1");
+	playUciMoves(c, "e2e4 e8d8 e1d1 d8e8 d1e1");
+	validateRepetitions(c, 2);
+	playUciMoves(c, "e8d8 e1d1 d8e8 d1e1");
+	validateRepetitions(c, 3);
+	chessFree(c);
+
+	// But one that can be captured on does
+	c = chessCreateFen("4k3/8/8/8/3p4/8/4P3/4K3 w - - 0 1");
+	playUciMoves(c, "e2e4 e8d8 e1d1 d8e8 d1e1");
+	validateRepetitions(c, 1);
+	playUciMoves(c, "e8d8 e1d1 d8e8 d1e1");
+	validateRepetitions(c, 2);
+	chessFree(c);
+}
+
+void validateTerminalState(chess *c, terminalState expected)
+{
+	if (chessGetTerminalState(c) != expected)
+	{
+		char message[50];
+		sprintf(message, "Terminal state was %d, expected %d", chessGetTerminalState(c), expected);
+		failTest(message);
+	}
+}
+
+void testChessTerminalState()
+{
+	// Fool's mate
+	chess *c = chessCreate();
+	playUciMoves(c, "f2f3 e7e5 g2g4");
+	validateTerminalState(c, tsOngoing);
+	playUciMoves(c, "d8h4");
+	validateTerminalState(c, tsCheckmate);
+	if (chessGetLegalMoves(c)->size != 0)
+		failTest("Checkmated side had legal moves");
+	if (chessPlayMove(c, moveFromUci("e1f2")) == 0)
+		failTest("Played a move after checkmate");
+
+	// Undoing brings back the moves, worked out again for the earlier position
+	chessUndo(c);
+	validateTerminalState(c, tsOngoing);
+	if (chessGetLegalMoves(c)->size != 30)
+		failTest("Wrong number of legal moves after undoing checkmate");
+	moveBuffer buf;
+	playUciMoves(c, "d8g5");
+	boardGenerateMovesInto(chessGetBoard(c), &buf);
+	if (chessGetLegalMoves(c)->size != buf.size)
+		failTest("Wrong number of legal moves after playing a different move");
+	chessFree(c);
+
+	// Stalemate, and illegal moves are rejected without changing anything
+	c = chessCreateFen("7k/8/6Q1/8/8/8/8/K7 w - - 0 1");
+	if (chessPlayMove(c, moveFromUci("g6e5")) == 0)
+		failTest("Played an illegal move");
+	if (chessPlayMove(c, moveFromUci("a1a1")) == 0)
+		failTest("Played a null move");
+	playUciMoves(c, "g6f7");
+	validateTerminalState(c, tsDrawStalemate);
+	chessFree(c);
+
+	// Checkmate on the move that reaches the 75 move rule is still checkmate
+	c = chessCreateFen("6k1/5ppp/8/8/8/8/8/R5K1 w - - 149 120");
+	validateTerminalState(c, tsOngoing);
+	playUciMoves(c, "a1a8");
+	validateTerminalState(c, tsCheckmate);
+	chessFree(c);
+
+	// Claiming a draw, then taking the claim back
+	c = chessCreateFen("4k3/8/8/8/8/8/4P3/4K3 w - - 99 80");
+	playUciMoves(c, "e1d1");
+	chessClaimDraw50(c);
+	validateTerminalState(c, tsDrawClaimed50MoveRule);
+	if (chessPlayMove(c, moveFromUci("e8d8")) == 0)
+		failTest("Played a move after claiming a draw");
+	chessUndo(c);
+	validateTerminalState(c, tsOngoing);
+	playUciMoves(c, "e8d8");
+	validateTerminalState(c, tsOngoing);
+	chessFree(c);
+}
+
+
+//////////////
+// TEST SAN //
+//////////////
+
+// HELPER - checks that the UCI move is written as the given SAN in the given position, and read back from it
+void validateSan(const char *fen, const char *uci, const char *san)
+{
+	board b;
+	boardInitFromFenInPlace(&b, fen);
+	move m = moveFromUci((char *) uci);
+
+	char buf[SAN_MAX_LENGTH];
+	if (moveToSan(&b, m, buf) != strlen(san))
+		failTest("moveToSan returned the wrong length");
+	validateString(buf, san);
+
+	if (!moveEq(moveFromSan(&b, san), m))
+		failTest("moveFromSan gave the wrong move");
+}
+
+// HELPER - checks that moveFromSan rejects the given SAN in the given position
+void validateSanInvalid(const char *fen, const char *san)
+{
+	board b;
+	boardInitFromFenInPlace(&b, fen);
+	if (!sqEq(moveFromSan(&b, san).from, SQ_INVALID))
+		failTest("moveFromSan accepted a bad move");
+}
+
+// HELPER - checks that every legal move goes to a SAN that's different from the others and reads back as the same move
+void checkSanRoundTrip(board *b)
+{
+	moveBuffer buf;
+	boardGenerateMovesInto(b, &buf);
+
+	char sans[MOVE_BUFFER_CAPACITY][SAN_MAX_LENGTH];
+	for (size_t i = 0; i < buf.size; i++)
+	{
+		move m = moveBufferGet(&buf, i);
+		moveToSan(b, m, sans[i]);
+		if (!moveEq(moveFromSan(b, sans[i]), m))
+			failTest("A move didn't survive being written as SAN and read back");
+		for (size_t j = 0; j < i; j++)
+		{
+			if (strcmp(sans[i], sans[j]) == 0)
+				failTest("Two moves had the same SAN");
+		}
+	}
+}
+
+void testMoveToSan()
+{
+	validateSan(INITIAL_FEN, "e2e4", "e4");
+	validateSan(INITIAL_FEN, "g1f3", "Nf3");
+
+	// Disambiguation by file, rank and both
+	validateSan("4k3/8/8/8/8/8/8/1N2KN2 w - - 0 1", "b1d2", "Nbd2");
+	validateSan("4k3/8/8/R7/8/8/8/R3K3 w - - 0 1", "a1a3", "R1a3");
+	validateSan("4k3/8/8/8/8/Q7/8/Q1Q1K3 w - - 0 1", "a1b2", "Qa1b2");
+
+	// A piece that can't legally get there doesn't need telling apart
+	validateSan("4r2k/8/8/8/8/8/4N3/1N2K3 w - - 0 1", "b1c3", "Nc3");
+	validateSan("7k/8/8/8/8/8/4N3/1N2K3 w - - 0 1", "b1c3", "Nbc3");
+
+	// Captures, en passant and promotions
+	validateSan("4k3/8/8/3pP3/8/8/8/4K3 w - d6 0 1", "e5d6", "exd6");
+	validateSan("3rk3/2P5/8/8/8/8/8/4K3 w - - 0 1", "c7d8q", "cxd8=Q+");
+	validateSan("3rk3/2P5/8/8/8/8/8/4K3 w - - 0 1", "c7c8n", "c8=N");
+	validateSan("r1bqkbnr/pppp1ppp/2n5/4p3/4P3/5N2/PPPP1PPP/RNBQKB1R w KQkq - 2 3", "f3e5", "Nxe5");
+
+	// Castling, check and mate
+	validateSan("r3k2r/8/8/8/8/8/8/R3K2R w KQkq - 0 1", "e1g1", "O-O");
+	validateSan("r3k2r/8/8/8/8/8/8/R3K2R b KQkq - 0 1", "e8c8", "O-O-O");
+	validateSan("4k3/8/8/8/8/8/8/R3K1KR w KQ - 0 1", "e1c1", "O-O-O");
+	validateSan("rnbqkbnr/ppppp2p/5p2/6p1/4P3/8/PPPP1PPP/RNBQKBNR w KQkq g6 0 3", "d1h5", "Qh5#");
+	validateSan("1n2kb1r/p4ppp/4q3/4p1B1/4P3/8/PPP2PPP/2KR4 w k - 0 17", "d1d8", "Rd8#");
+	validateSan("4k3/8/8/8/8/8/8/R3K3 w Q - 0 1", "a1a8", "Ra8+");
+
+	// Every move in a few busy positions
+	walkReferencePositions(2, checkSanRoundTrip);
+	board b;
+	boardInitFromFenInPlace(&b, "n1n5/PPPk4/8/8/8/8/4Kppp/5N1N b - - 0 1");
+	walkPositions(&b, 1, checkSanRoundTrip);
+	boardInitFromFenInPlace(&b, "4k3/8/8/8/8/Q7/8/Q1Q1K3 w - - 0 1");
+	walkPositions(&b, 1, checkSanRoundTrip);
+}
+
+void testMoveFromSan()
+{
+	// Check marks, annotations, zeros for castling and a missing '=' are all fine
+	validateSan(INITIAL_FEN, "e2e4", "e4");
+	board b;
+	boardInitInPlace(&b);
+	if (!moveEq(moveFromSan(&b, "e4!?"), moveFromUci("e2e4")))
+		failTest("Annotations weren't ignored");
+	boardInitFromFenInPlace(&b, "r3k2r/8/8/8/8/8/8/R3K2R w KQkq - 0 1");
+	if (!moveEq(moveFromSan(&b, "0-0-0+"), moveFromUci("e1c1")))
+		failTest("Castling with zeros wasn't read");
+	boardInitFromFenInPlace(&b, "3rk3/2P5/8/8/8/8/8/4K3 w - - 0 1");
+	if (!moveEq(moveFromSan(&b, "cxd8Q"), moveFromUci("c7d8q")))
+		failTest("A promotion without '=' wasn't read");
+
+	// Ambiguous, illegal and nonsense moves
+	validateSanInvalid("4k3/8/8/8/8/8/8/1N2KN2 w - - 0 1", "Nd2");
+	validateSanInvalid("4k3/8/8/8/8/Q7/8/Q1Q1K3 w - - 0 1", "Qab2");
+	validateSanInvalid(INITIAL_FEN, "e5");
+	validateSanInvalid(INITIAL_FEN, "Nf4");
+	validateSanInvalid(INITIAL_FEN, "O-O");
+	validateSanInvalid(INITIAL_FEN, "exd3");
+	validateSanInvalid(INITIAL_FEN, "Zz9");
+	validateSanInvalid(INITIAL_FEN, "");
+	validateSanInvalid("3rk3/2P5/8/8/8/8/8/4K3 w - - 0 1", "c8");
+}
+
+
+//////////////
+// TEST PGN //
+//////////////
+
+#define PGN_TEST_MAX_GAMES 8
+
+// HELPER - everything the PGN callbacks were given
+typedef struct
+{
+	unsigned int games;
+	unsigned int moves;
+	unsigned int tags;
+	char event[PGN_MAX_TAG_VALUE];
+	char fens[PGN_TEST_MAX_GAMES][FEN_MAX_LENGTH];
+	char results[PGN_TEST_MAX_GAMES][8];
+	unsigned int plies[PGN_TEST_MAX_GAMES];
+	pgnErrorCode errors[PGN_TEST_MAX_GAMES];
+} pgnTestResults;
+
+void pgnTestOnTag(void *data, const char *name, const char *value)
+{
+	pgnTestResults *results = (pgnTestResults *) data;
+	results->tags++;
+	if (strcmp(name, "Event") == 0 && results->event[0] == 0)
+		strcpy(results->event, value);
+}
+
+void pgnTestOnMove(void *data, board *b, move m, unsigned int ply)
+{
+	pgnTestResults *results = (pgnTestResults *) data;
+	results->moves++;
+	if (pieceGetColor(boardGetPiece(b, m.to)) == b->currentPlayer)
+		failTest("The move callback was given the wrong board");
+}
+
+void pgnTestOnGameEnd(void *data, board *b, const char *result, unsigned int plies, pgnErrorCode error)
+{
+	pgnTestResults *results = (pgnTestResults *) data;
+	if (results->games >= PGN_TEST_MAX_GAMES)
+		failTest("Too many games");
+	boardWriteFen(b, results->fens[results->games], FEN_MAX_LENGTH);
+	strcpy(results->results[results->games], result);
+	results->plies[results->games] = plies;
+	results->errors[results->games] = error;
+	results->games++;
+}
+
+// HELPER - checks one of the games the callbacks were given
+void validatePgnGame(pgnTestResults *results, unsigned int game, const char *fen, const char *result,
+		unsigned int plies, pgnErrorCode error)
+{
+	validateString(results->fens[game], fen);
+	validateString(results->results[game], result);
+	if (results->plies[game] != plies)
+		failTest("Game had the wrong number of plies");
+	if (results->errors[game] != error)
+		failTest("Game had the wrong error");
+}
+
+void testPgnRead()
+{
+	const char *pgn =
+		"[Event \"Paris \\\"Opera\\\" game\"]\n"
+		"[White \"Paul Morphy\"]\n"
+		"[Black \"Duke Karl / Count Isouard\"]\n"
+		"[Result \"1-0\"]\n"
+		"\n"
+		"1. e4 e5 2. Nf3 d6 3. d4 Bg4 {This is a weak move\n"
+		"already (says who?)} 4. dxe5 Bxf3 (4... dxe5 5. Qxd8+ (5. Nxe5 {or this}) Kxd8) 5. Qxf3 dxe5\n"
+		"% an escaped line 6. e5\n"
+		"6.Bc4 Nf6 7.Qb3 Qe7 8.Nc3 c6 $2 9.Bg5 b5 10.Nxb5 cxb5 11.Bxb5+ Nbd7 12.O-O-O Rd8 ; comment 13. a4\n"
+		"13.Rxd7 Rxd7 14.Rd1 Qe6 15.Bxd7+ Nxd7 16.Qb8+!! Nxb8 17.Rd8# 1-0\n"
+		"\n"
+		"[Event \"From a position\"]\n"
+		"[SetUp \"1\"]\n"
+		"[FEN \"4k3/1P6/8/3pP3/8/8/8/4K3 w - d6 0 1\"]\n"
+		"\n"
+		"1. exd6 Kd7 2. b8=N Kxd6 *\n"
+		"\n"
+		"[Event \"Illegal\"]\n"
+		"1. e4 e5 2. Ke3 Nc6 0-1\n"
+		"[Event \"Unfinished\"]\n"
+		"1. d4 d5 2. c4";
+
+	pgnTestResults results;
+	memset(&results, 0, sizeof(results));
+	pgnCallbacks callbacks = {pgnTestOnTag, pgnTestOnMove, pgnTestOnGameEnd, &results};
+
+	if (pgnReadBuffer(pgn, strlen(pgn), &callbacks) != 4 || results.games != 4)
+		failTest("Wrong number of games read");
+	if (results.tags != 9)
+		failTest("Wrong number of tags read");
+	if (results.moves != 33 + 4 + 2 + 3)
+		failTest("Wrong number of moves read");
+	validateString(results.event, "Paris \"Opera\" game");
+
+	validatePgnGame(&results, 0, "1n1Rkb1r/p4ppp/4q3/4p1B1/4P3/8/PPP2PPP/2K5 b k - 1 17", "1-0", 33, peNone);
+	validatePgnGame(&results, 1, "1N6/8/3k4/8/8/8/8/4K3 w - - 0 3", "*", 4, peNone);
+	validatePgnGame(&results, 2, "rnbqkbnr/pppp1ppp/8/4p3/4P3/8/PPPP1PPP/RNBQKBNR w KQkq e6 0 2", "0-1", 2, peBadMove);
+	validatePgnGame(&results, 3, "rnbqkbnr/ppp1pppp/8/3p4/2PP4/8/PP2PPPP/RNBQKBNR b KQkq c3 0 2", "*", 3, peNone);
+
+	// Fed one byte at a time, the same games come out
+	pgnTestResults split;
+	memset(&split, 0, sizeof(split));
+	callbacks.data = &split;
+	pgnReader r;
+	pgnReaderInit(&r, &callbacks);
+	for (size_t i = 0; i < strlen(pgn); i++)
+		pgnReaderFeed(&r, pgn + i, 1);
+	pgnReaderFinish(&r);
+	if (r.games != 4 || memcmp(&results, &split, sizeof(results)) != 0)
+		failTest("Feeding one byte at a time gave different results");
+
+	// Reading from a file descriptor
+	FILE *f = tmpfile();
+	if (f == NULL)
+		failTest("Couldn't create a temporary file");
+	fputs(pgn, f);
+	fflush(f);
+	rewind(f);
+	memset(&split, 0, sizeof(split));
+	if (pgnReadFd(fileno(f), &callbacks) != 4 || memcmp(&results, &split, sizeof(results)) != 0)
+		failTest("Reading from a file descriptor gave different results");
+	fclose(f);
+
+	// Moves that could be more than one piece need to say which
+	const char *ambiguous =
+		"[FEN \"4k3/8/8/R7/8/8/8/RN2KN2 w - - 0 1\"]\n"
+		"1. Nbd2 Kd7 2. Nfe3 Kd6 3. R1a3 Kd7 4. R5a4 *\n"
+		"[FEN \"4k3/8/8/R7/8/8/8/RN2KN2 w - - 0 1\"]\n"
+		"1. Nd2 *\n"
+		"[FEN \"4k3/8/8/R7/8/8/8/RN2KN2 w - - 0 1\"]\n"
+		"1. Ra3 *\n"
+		"[FEN \"not a fen\"]\n"
+		"1. e4 *\n";
+	memset(&results, 0, sizeof(results));
+	callbacks.data = &results;
+	if (pgnReadBuffer(ambiguous, strlen(ambiguous), &callbacks) != 4)
+		failTest("Wrong number of games read");
+	validatePgnGame(&results, 0, "8/3k4/8/8/R7/R3N3/3N4/4K3 b - - 7 4", "*", 7, peNone);
+	validatePgnGame(&results, 1, "4k3/8/8/R7/8/8/8/RN2KN2 w - - 0 1", "*", 0, peBadMove);
+	validatePgnGame(&results, 2, "4k3/8/8/R7/8/8/8/RN2KN2 w - - 0 1", "*", 0, peBadMove);
+	if (results.errors[3] != peBadFen || results.plies[3] != 0)
+		failTest("A bad FEN tag wasn't reported");
+}
+
+
+//////////////
+// TEST EPD //
+//////////////
+
+// HELPER - runs epdProcessBuffer (or epdProcessFile if path isn't NULL) and returns everything it wrote. Must be freed
+char *runEpd(const char *text, const char *path, const epdOptions *options)
+{
+	FILE *out = tmpfile();
+	if (out == NULL)
+		failTest("Couldn't create a temporary file");
+
+	if (path)
+	{
+		if (epdProcessFile(path, options, out))
+			failTest("epdProcessFile couldn't read the file");
+	}
+	else
+	{
+		epdProcessBuffer(text, strlen(text), options, out);
+	}
+
+	long len = ftell(out);
+	rewind(out);
+	char *result = (char *) malloc(len + 1);
+	if (fread(result, 1, len, out) != (size_t) len)
+		failTest("Couldn't read back the results");
+	result[len] = 0;
+	fclose(out);
+	return result;
+}
+
+// HELPER - an EPD callback that writes the position back out as a FEN
+size_t epdTestWriteFen(void *data, board *b, const char *line, size_t len, char *out, size_t cap)
+{
+	(*(int *) data)++;
+	return boardWriteFen(b, out, cap);
+}
+
+void testEpdProcess()
+{
+	const char *text =
+		"rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1\n"
+		"r3k2r/p1ppqpb1/bn2pnp1/3PN3/1p2P3/2N2Q1p/PPPBBPPP/R3K2R w KQkq - bm e2a6; id \"kiwipete\";\n"
+		"\n"
+		"   8/8/8/8/8/8/8/k6K w - -   \n"
+		"rnb1kbnr/pppp1ppp/8/4p3/6Pq/5P2/PPPPP2P/RNBQKBNR w KQkq - 1 3\r\n"
+		"not a fen\n"
+		"4k3/8/8/8/8/8/4P3/4K3 w - - ;D1 6";
+
+	epdOptions options;
+	memset(&options, 0, sizeof(options));
+	options.numThreads = 1;
+
+	options.operation = eoLegalMoves;
+	char *result = runEpd(text, NULL, &options);
+	validateString(result, "20\n48\n3\n0\nerror: Unknown piece at character 1\n6\n");
+	free(result);
+
+	options.operation = eoInCheck;
+	result = runEpd(text, NULL, &options);
+	validateString(result, "0\n0\n0\n1\nerror: Unknown piece at character 1\n0\n");
+	free(result);
+
+	options.operation = eoInsufficientMaterial;
+	result = runEpd(text, NULL, &options);
+	validateString(result, "0\n0\n1\n0\nerror: Unknown piece at character 1\n0\n");
+	free(result);
+
+	options.operation = eoPerft;
+	options.depth = 2;
+	result = runEpd(text, NULL, &options);
+	validateString(result, "400\n2039\n9\n0\nerror: Unknown piece at character 1\n30\n");
+	free(result);
+
+	int calls = 0;
+	options.operation = eoCallback;
+	options.callback = epdTestWriteFen;
+	options.data = &calls;
+	result = runEpd(text, NULL, &options);
+	validateString(result,
+		"rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1\n"
+		"r3k2r/p1ppqpb1/bn2pnp1/3PN3/1p2P3/2N2Q1p/PPPBBPPP/R3K2R w KQkq - 0 1\n"
+		"8/8/8/8/8/8/8/k6K w - - 0 1\n"
+		"rnb1kbnr/pppp1ppp/8/4p3/6Pq/5P2/PPPPP2P/RNBQKBNR w KQkq - 1 3\n"
+		"error: Unknown piece at character 1\n"
+		"4k3/8/8/8/8/8/4P3/4K3 w - - 0 1\n");
+	free(result);
+	if (calls != 5)
+		failTest("The callback was called the wrong number of times");
+
+	// Lots of positions split between threads still come out in order
+	size_t blockLength = strlen(text) + 1;
+	size_t blocks = 2000;
+	char *big = (char *) malloc(blockLength * blocks + 1);
+	for (size_t i = 0; i < blocks; i++)
+	{
+		memcpy(big + i * blockLength, text, blockLength - 1);
+		big[(i + 1) * blockLength - 1] = '\n';
+	}
+	big[blockLength * blocks] = 0;
+
+	options.operation = eoLegalMoves;
+	options.numThreads = 1;
+	char *expected = runEpd(big, NULL, &options);
+	if (strlen(expected) != blocks * strlen("20\n48\n3\n0\nerror: Unknown piece at character 1\n6\n"))
+		failTest("Wrong amount of output for many positions");
+
+	options.numThreads = 4;
+	result = runEpd(big, NULL, &options);
+	validateString(result, expected);
+	free(result);
+
+	// Reading from a file gives the same results
+	char path[] = "/tmp/chesslibXXXXXX";
+	int fd = mkstemp(path);
+	if (fd < 0)
+		failTest("Couldn't create a temporary file");
+	if (write(fd, big, strlen(big)) != (ssize_t) strlen(big))
+		failTest("Couldn't write the temporary file");
+	close(fd);
+	result = runEpd(NULL, path, &options);
+	validateString(result, expected);
+	free(result);
+	unlink(path);
+
+	if (epdProcessFile("/nonexistent/file.epd", &options, stdout) == 0)
+		failTest("epdProcessFile read a file that doesn't exist");
+
+	free(expected);
+	free(big);
+}
+
+
+///////////////
+// TEST BOOK //
+///////////////
+
+// HELPER - a book entry to be written out by buildBook
+typedef struct
+{
+	uint64_t key;
+	uint16_t move;
+	uint16_t weight;
+	size_t order; 	// Keeps entries with the same key in the order they were added
+} bookTestEntry;
+
+int compareBookTestEntries(const void *a, const void *b)
+{
+	const bookTestEntry *e1 = (const bookTestEntry *) a;
+	const bookTestEntry *e2 = (const bookTestEntry *) b;
+	if (e1->key != e2->key)
+		return e1->key < e2->key ? -1 : 1;
+	return e1->order < e2->order ? -1 : (e1->order > e2->order);
+}
+
+// HELPER - encodes a UCI move the way Polyglot does
+uint16_t bookTestMove(const char *uci)
+{
+	uint16_t raw = (uci[2] - 'a') | ((uci[3] - '1') << 3) | ((uci[0] - 'a') << 6) | ((uci[1] - '1') << 9);
+	if (uci[4] == 'n')
+		raw |= 1 << 12;
+	else if (uci[4] == 'q')
+		raw |= 4 << 12;
+	return raw;
+}
+
+// HELPER - sorts the entries and writes them out as a book file would be. Must be freed
+uint8_t *buildBook(bookTestEntry *entries, size_t numEntries)
+{
+	for (size_t i = 0; i < numEntries; i++)
+		entries[i].order = i;
+	qsort(entries, numEntries, sizeof(bookTestEntry), compareBookTestEntries);
+
+	uint8_t *data = (uint8_t *) calloc(numEntries, BOOK_ENTRY_SIZE);
+	for (size_t i = 0; i < numEntries; i++)
+	{
+		uint8_t *bytes = data + i * BOOK_ENTRY_SIZE;
+		for (int j = 0; j < 8; j++)
+			bytes[j] = entries[i].key >> (56 - 8 * j);
+		bytes[8] = entries[i].move >> 8;
+		bytes[9] = entries[i].move & 0xFF;
+		bytes[10] = entries[i].weight >> 8;
+		bytes[11] = entries[i].weight & 0xFF;
+	}
+	return data;
+}
+
+// HELPER - returns the key of a FEN
+uint64_t bookTestKey(const char *fen, const uint64_t *random)
+{
+	board b;
+	boardInitFromFenInPlace(&b, fen);
+	return bookGetKey(&b, random);
+}
+
+// HELPER - checks the moves found for a position
+void validateBookMoves(book *bk, const char *fen, const char *ucis[], uint16_t weights[], size_t count)
+{
+	board b;
+	boardInitFromFenInPlace(&b, fen);
+
+	bookEntry entries[8];
+	if (bookFind(bk, &b, entries, 8) != count)
+		failTest("bookFind found the wrong number of entries");
+	for (size_t i = 0; i < count; i++)
+	{
+		if (!moveEq(entries[i].m, moveFromUci((char *) ucis[i])) || entries[i].weight != weights[i])
+			failTest("bookFind found the wrong entry");
+	}
+}
+
+// HELPER - checks the key with the built in table after playing the UCI moves from the starting position
+void validateBookKey(const char *ucis, uint64_t expected)
+{
+	chess *c = chessCreate();
+	playUciMoves(c, ucis);
+	if (bookGetKey(chessGetBoard(c), NULL) != expected)
+		failTest("Wrong key with the Polyglot table");
+	chessFree(c);
+}
+
+void testBook()
+{
+	const uint64_t *random = bookPolyglotRandom;
+
+	// Keys from the Polyglot book format description
+	validateBookKey("", 0x463B96181691FC9C);
+	validateBookKey("e2e4", 0x823C9B50FD114196);
+	validateBookKey("e2e4 d7d5", 0x0756B94461C50FB0);
+	validateBookKey("e2e4 d7d5 e4e5", 0x662FAFB965DB29D4);
+	validateBookKey("e2e4 d7d5 e4e5 f7f5", 0x22A48B5A8E47FF78);
+	validateBookKey("e2e4 d7d5 e4e5 f7f5 e1e2", 0x652A607CA3F242C1);
+	validateBookKey("e2e4 d7d5 e4e5 f7f5 e1e2 e8f7", 0x00FDD303C946BDD9);
+	validateBookKey("a2a4 b7b5 h2h4 b5b4 c2c4", 0x3C8123EA7B067637);
+	validateBookKey("a2a4 b7b5 h2h4 b5b4 c2c4 b4c3 a1a3", 0x5C3F9B829B279560);
+
+	// Keys are laid out the way Polyglot does it
+	if (bookTestKey("7k/8/8/8/8/8/8/K7 b - - 0 1", random) != (random[64 * 11 + 0] ^ random[64 * 10 + 63]))
+		failTest("Wrong key for two kings");
+	if (bookTestKey("7k/8/8/8/8/8/8/K7 w - - 0 1", random)
+			!= (random[64 * 11 + 0] ^ random[64 * 10 + 63] ^ random[780]))
+		failTest("Wrong key with white to move");
+	if ((bookTestKey("4k3/8/8/8/8/8/3p4/R3K2R b KQ - 0 1", random) ^ bookTestKey("4k3/8/8/8/8/8/3p4/R3K2R b - - 0 1",
+			random)) != (random[768] ^ random[769]))
+		failTest("Wrong key for castling rights");
+	if (bookTestKey("4k3/8/8/8/8/8/3p4/4K3 b - - 0 1", random) != (random[64 * 11 + 4] ^ random[64 * 10 + 60]
+			^ random[64 * 0 + 11]))
+		failTest("Wrong key for a black pawn");
+
+	// En passant only counts with a pawn next to the one that moved
+	if (bookTestKey("rnbqkbnr/pppppppp/8/8/4P3/8/PPPP1PPP/RNBQKBNR b KQkq e3 0 1", random)
+			!= bookTestKey("rnbqkbnr/pppppppp/8/8/4P3/8/PPPP1PPP/RNBQKBNR b KQkq - 0 1", random))
+		failTest("En passant counted with no pawn to capture");
+	if ((bookTestKey("rnbqkbnr/ppp1p1pp/8/3pPp2/8/8/PPPP1PPP/RNBQKBNR w KQkq f6 0 3", random)
+			^ bookTestKey("rnbqkbnr/ppp1p1pp/8/3pPp2/8/8/PPPP1PPP/RNBQKBNR w KQkq - 0 3", random)) != random[772 + 5])
+		failTest("Wrong key for en passant");
+
+	const char *castleFen = "r3k2r/8/8/8/8/8/8/R3K2R b KQkq - 0 1";
+	const char *promoteFen = "8/P6k/8/8/8/8/8/K7 w - - 0 1";
+	uint64_t startKey = bookTestKey(INITIAL_FEN, random);
+
+	size_t numEntries = 1000;
+	bookTestEntry entries[1000];
+	size_t n = 0;
+	entries[n++] = (bookTestEntry) {startKey, bookTestMove("e2e4"), 10};
+	entries[n++] = (bookTestEntry) {startKey, bookTestMove("e2e5"), 100}; 	// Illegal, so skipped
+	entries[n++] = (bookTestEntry) {startKey, bookTestMove("d2d4"), 5};
+	entries[n++] = (bookTestEntry) {startKey, bookTestMove("g1f3"), 1};
+	entries[n++] = (bookTestEntry) {bookTestKey(castleFen, random), bookTestMove("e8a8"), 3};
+	entries[n++] = (bookTestEntry) {bookTestKey(castleFen, random), bookTestMove("e8h8"), 0};
+	entries[n++] = (bookTestEntry) {bookTestKey(promoteFen, random), bookTestMove("a7a8q"), 1};
+	entries[n++] = (bookTestEntry) {bookTestKey(promoteFen, random), bookTestMove("a7a8n"), 1};
+	while (n < numEntries)
+	{
+		entries[n] = (bookTestEntry) {random[n % BOOK_RANDOM_COUNT] * (n + 1), bookTestMove("a1a2"), 1};
+		n++;
+	}
+	uint8_t *data = buildBook(entries, numEntries);
+
+	book bk;
+	bookOpenBuffer(&bk, data, numEntries * BOOK_ENTRY_SIZE, NULL);
+	if (bk.numEntries != numEntries)
+		failTest("Wrong number of entries in the book");
+
+	const char *startMoves[] = {"e2e4", "d2d4", "g1f3"};
+	uint16_t startWeights[] = {10, 5, 1};
+	validateBookMoves(&bk, INITIAL_FEN, startMoves, startWeights, 3);
+
+	// Castling is stored as the king taking its rook, and promotions have their own bits
+	const char *castleMoves[] = {"e8c8", "e8g8"};
+	uint16_t castleWeights[] = {3, 0};
+	validateBookMoves(&bk, castleFen, castleMoves, castleWeights, 2);
+	const char *promoteMoves[] = {"a7a8q", "a7a8n"};
+	uint16_t promoteWeights[] = {1, 1};
+	validateBookMoves(&bk, promoteFen, promoteMoves, promoteWeights, 2);
+
+	board b;
+	boardInitInPlace(&b);
+	if (!moveEq(bookGetBestMove(&bk, &b), moveFromUci("e2e4")))
+		failTest("Wrong best move");
+
+	// Weighted picks land in proportion to the weights
+	for (uint32_t r = 0; r < 32; r++)
+	{
+		const char *expected = (r % 16 < 10) ? "e2e4" : ((r % 16 < 15) ? "d2d4" : "g1f3");
+		if (!moveEq(bookGetWeightedMove(&bk, &b, r), moveFromUci((char *) expected)))
+			failTest("Wrong weighted move");
+	}
+
+	// Moves with no weight are never picked at random
+	boardInitFromFenInPlace(&b, castleFen);
+	if (!moveEq(bookGetWeightedMove(&bk, &b, 2), moveFromUci("e8c8")))
+		failTest("Picked a move with no weight");
+
+	// Positions not in the book
+	boardInitFromFenInPlace(&b, "rnbqkbnr/pppppppp/8/8/4P3/8/PPPP1PPP/RNBQKBNR b KQkq e3 0 1");
+	if (bookFind(&bk, &b, NULL, 0) != 0 || !sqEq(bookGetBestMove(&bk, &b).from, SQ_INVALID)
+			|| !sqEq(bookGetWeightedMove(&bk, &b, 7).from, SQ_INVALID))
+		failTest("Found moves for a position that isn't in the book");
+	bookClose(&bk);
+
+	// The same book read from a file
+	char path[] = "/tmp/chesslibXXXXXX";
+	int fd = mkstemp(path);
+	if (fd < 0)
+		failTest("Couldn't create a temporary file");
+	if (write(fd, data, numEntries * BOOK_ENTRY_SIZE) != (ssize_t) (numEntries * BOOK_ENTRY_SIZE))
+		failTest("Couldn't write the temporary file");
+	close(fd);
+	if (bookOpen(&bk, path, NULL))
+		failTest("Couldn't open the book file");
+	validateBookMoves(&bk, INITIAL_FEN, startMoves, startWeights, 3);
+	validateBookMoves(&bk, castleFen, castleMoves, castleWeights, 2);
+	bookClose(&bk);
+	unlink(path);
+
+	if (bookOpen(&bk, "/nonexistent/book.bin", NULL) == 0)
+		failTest("Opened a book that doesn't exist");
+
+	free(data);
+}
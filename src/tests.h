@@ -19,6 +19,8 @@ void testSqIsDark();
 void testMoveCreate();
 void testMoveFromUci();
 void testMoveGetUci();
+void testMoveWriteUci();
+void testMovePack();
 
 // Move list testing
 void testMoveList();
@@ -26,7 +28,10 @@ void testMoveList();
 // Board testing
 void testBoardCreate();
 void testBoardCreateFromFen();
+void testBoardParseFen();
 void testBoardEq();
+void testBoardBitboards();
+void testBoardHash();
 
 // Piece moves testing
 void testPawnMoves();
@@ -35,23 +40,34 @@ void testBishopMoves();
 void testRookMoves();
 void testQueenMoves();
 void testKingMoves();
+void testSliderAttackSets();
 
 // Square attacking/check testing
 void testIsSquareAttacked();
 void testIsInCheck();
+void testBoardAttackersOf();
+void testBoardGetKingSquare();
 
 // Test playing moves
 void testBoardPlayMove();
+void testBoardMakeUnmakeMove();
 
 // Test full move generation
 void testBoardGenerateMoves();
 void testBoardGenerateMovesCastling();
+void testBoardGenerateMovesInto();
+void testBoardGenerateMovesPinsAndChecks();
+void testBoardCountLegalMoves();
+void testBoardIsMoveLegal();
+void testBoardGenerateStages();
 
 // Test FEN generation
 void testBoardGetFen();
+void testBoardWriteFen();
 
 // Test draw by insufficient material
 void testBoardIsInsufficientMaterial();
+void testBoardMaterialKey();
 
 // Test board list
 void testBoardList();
@@ -59,3 +75,23 @@ void testBoardList();
 // Test square set
 void testSqSetSet();
 void testSqSetGet();
+
+// Test perft
+void testPerft();
+
+// Test chess game
+void testChessRepetitions();
+void testChessTerminalState();
+
+// Test SAN
+void testMoveToSan();
+void testMoveFromSan();
+
+// Test PGN
+void testPgnRead();
+
+// Test EPD
+void testEpdProcess();
+
+// Test opening books
+void testBook();